@@ -1,6 +1,16 @@
 #pragma once
 #include <esphome.h>
 #include <esphome/core/preferences.h>
+#include "frameReader.h"
+#include "protocolTables.h"
+#include "cn105Codec.h"
+#include "txQueue.h"
+#include "rttEstimator.h"
+#include "latencyHistogram.h"
+#include "publishFilter.h"
+#include "packetTrace.h"
+#include "cn105Transport.h"
+#include "cn105Clock.h"
 
 #if defined(ARDUINO) && ARDUINO >= 100
 #include "Arduino.h"
@@ -8,35 +18,44 @@
 #include "WProgram.h"
 #endif
 
-#define CUSTOM_MILLIS ::millis()
-#define MAX_DATA_BYTES     64       // max number of data bytes in incoming messages
-#define MAX_DELAY_RESPONSE_FACTOR 3    // 30 seconds max without response
-
 
 static const char* LOG_ACTION_EVT_TAG = "EVT_SETS";
 static const char* TAG = "CN105"; // Logging tag
 static const char* LOG_SETTINGS_TAG = "SETTINGS"; // Logging tag
 static const char* LOG_STATUS_TAG = "STATUS"; // Logging tag
 
+/**
+ * the log level of these subsystems can be changed at runtime with set_log_level()
+ * CN105_LOGx(subsystem, tag, ...) neither formats nor evaluates its arguments when the level is disabled,
+ * and it is removed by the compiler when the esphome logger level is lower
+*/
+enum logSubsystem : uint8_t {
+    LOG_SUBSYSTEM_DECODER,      // content of the received packets
+    LOG_SUBSYSTEM_WRITER,       // packets built and sent
+    LOG_SUBSYSTEM_SETTINGS,     // settings and status changes
+    LOG_SUBSYSTEM_COUNT
+};
+static const uint8_t DEFAULT_SUBSYSTEM_LOG_LEVEL = ESPHOME_LOG_LEVEL;     // the logger level decides until a subsystem is narrowed
+
+#define CN105_LOG_ENABLED(subsystem, level) ((ESPHOME_LOG_LEVEL >= (level)) && (this->logLevels[(subsystem)] >= (level)))
+#define CN105_LOGI(subsystem, tag, ...) do { if (CN105_LOG_ENABLED(subsystem, ESPHOME_LOG_LEVEL_INFO)) { ESP_LOGI(tag, __VA_ARGS__); } } while (0)
+#define CN105_LOGD(subsystem, tag, ...) do { if (CN105_LOG_ENABLED(subsystem, ESPHOME_LOG_LEVEL_DEBUG)) { ESP_LOGD(tag, __VA_ARGS__); } } while (0)
+#define CN105_LOGV(subsystem, tag, ...) do { if (CN105_LOG_ENABLED(subsystem, ESPHOME_LOG_LEVEL_VERBOSE)) { ESP_LOGV(tag, __VA_ARGS__); } } while (0)
+
 static const char* SHEDULER_INTERVAL_SYNC_NAME = "hp->sync"; // name of the scheduler to prpgram hp updates
 static const char* DEFER_SHEDULER_INTERVAL_SYNC_NAME = "hp->sync_defer"; // name of the scheduler to prpgram hp updates
+static const char* POLL_REPLY_TIMEOUT_NAME = "hp->poll_reply"; // name of the scheduler waiting for the reply to a poll request
+static const char* CONNECT_RETRY_NAME = "hp->connect_retry"; // name of the scheduler trying the connection again
 
 static const int DEFER_SCHEDULE_UPDATE_LOOP_DELAY = 500;
-static const int PACKET_LEN = 22;
 static const int PACKET_SENT_INTERVAL_MS = 1000;
 static const int PACKET_INFO_INTERVAL_MS = 2000;
 static const int PACKET_TYPE_DEFAULT = 99;
+static const int ADAPTIVE_FAST_PERIOD_MS = 30000;     // poll at min_update_interval for this long after an activity
+static const int ADAPTIVE_STABLE_AFTER_MS = 120000;   // without activity for this long the interval backs off towards max_update_interval
+static const int DEFAULT_COMMAND_COALESCING_WINDOW_MS = 300;   // quiet time after the last control() before the set packet is sent
 static const int AUTOUPDATE_GRACE_PERIOD_IGNORE_EXTERNAL_UPDATES_MS = 30000;
 
-static const int CONNECT_LEN = 8;
-static const uint8_t CONNECT[CONNECT_LEN] = { 0xfc, 0x5a, 0x01, 0x30, 0x02, 0xca, 0x01, 0xa8 };
-static const int HEADER_LEN = 8;
-static const uint8_t HEADER[HEADER_LEN] = { 0xfc, 0x41, 0x01, 0x30, 0x10, 0x01, 0x00, 0x00 };
-
-static const int INFOHEADER_LEN = 5;
-static const uint8_t INFOHEADER[INFOHEADER_LEN] = { 0xfc, 0x42, 0x01, 0x30, 0x10 };
-
-
 static const int INFOMODE_LEN = 6;
 static const uint8_t INFOMODE[INFOMODE_LEN] = {
   0x02, // request a settings packet - RQST_PKT_SETTINGS
@@ -59,36 +78,11 @@ static const int RCVD_PKT_FUNCTIONS = 7;
 
 // the nb of request without response before we declare UART is not connected anymore
 static const int MAX_NON_RESPONSE_REQ = 5;
+static const int MAX_FAILED_TRANSACTIONS = 3;     // consecutive requests without reply, despite the retransmissions, before the UART is reconnected
 
-static const uint8_t CONTROL_PACKET_1[5] = { 0x01,    0x02,  0x04,  0x08, 0x10 };
-//{"POWER","MODE","TEMP","FAN","VANE"};
-static const uint8_t CONTROL_PACKET_2[1] = { 0x01 };
-//{"WIDEVANE"};
-static const uint8_t POWER[2] = { 0x00, 0x01 };
-static const char* POWER_MAP[2] = { "OFF", "ON" };
-static const uint8_t MODE[5] = { 0x01,   0x02,  0x03, 0x07, 0x08 };
-static const char* MODE_MAP[5] = { "HEAT", "DRY", "COOL", "FAN", "AUTO" };
-static const uint8_t TEMP[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
-static const int TEMP_MAP[16] = { 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16 };
-static const uint8_t FAN[6] = { 0x00,  0x01,   0x02, 0x03, 0x05, 0x06 };
-static const char* FAN_MAP[6] = { "AUTO", "QUIET", "1", "2", "3", "4" };
-static const uint8_t VANE[7] = { 0x00,  0x01, 0x02, 0x03, 0x04, 0x05, 0x07 };
-static const char* VANE_MAP[7] = { "AUTO", "1", "2", "3", "4", "5", "SWING" };
-static const uint8_t WIDEVANE[7] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x0c };
-static const char* WIDEVANE_MAP[7] = { "<<", "<",  "|",  ">",  ">>", "<>", "SWING" };
-static const uint8_t ROOM_TEMP[32] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
-                                  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f };
-static const int ROOM_TEMP_MAP[32] = { 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
-                                  26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41 };
-static const uint8_t TIMER_MODE[4] = { 0x00,  0x01,  0x02, 0x03 };
-static const char* TIMER_MODE_MAP[4] = { "NONE", "OFF", "ON", "BOTH" };
-
-static const int TIMER_INCREMENT_MINUTES = 10;
-
-static const uint8_t FUNCTIONS_SET_PART1 = 0x1F;
-static const uint8_t FUNCTIONS_GET_PART1 = 0x20;
-static const uint8_t FUNCTIONS_SET_PART2 = 0x21;
-static const uint8_t FUNCTIONS_GET_PART2 = 0x22;
+// the byte <-> value encodings (POWER_MAP, MODE_MAP, TEMP_MAP, FAN_MAP, VANE_MAP, WIDEVANE_MAP,
+// ROOM_TEMP_MAP, TIMER_MODE_MAP) and the packets layout are described in protocolTables.h,
+// the packets are built and decoded by cn105Codec.h
 
 
 // Déclaration de la constante - pas de définition ici
@@ -104,121 +98,151 @@ static const int RQST_PKT_TIMERS = 3;
 static const int RQST_PKT_STATUS = 4;
 static const int RQST_PKT_STANDBY = 5;
 
+// poll period of each INFOMODE request: 0 means at each poll cycle
+static const uint32_t POLL_PERIOD_EVERY_CYCLE = 0;
+static const uint32_t POLL_PERIOD_NEVER = 0xFFFFFFFF;    // same value as the esphome "never" update interval
+static const uint32_t DEFAULT_POLL_PERIODS[INFOMODE_LEN] = {
+  POLL_PERIOD_EVERY_CYCLE,  // settings
+  POLL_PERIOD_EVERY_CYCLE,  // room temperature
+  POLL_PERIOD_NEVER,        // 0x04 unknown
+  POLL_PERIOD_NEVER,        // timers
+  POLL_PERIOD_EVERY_CYCLE,  // status
+  POLL_PERIOD_NEVER         // standby
+};
+
+/**
+ * latencies measured by the component, see dump_latency_histograms()
+ * a reply is timed from the first transmission of its request, retransmissions included
+*/
+enum latencyKind : uint8_t {
+    LATENCY_SETTINGS_REPLY,     // 0x42 0x02 -> 0x62
+    LATENCY_ROOM_TEMP_REPLY,    // 0x42 0x03 -> 0x62
+    LATENCY_STATUS_REPLY,       // 0x42 0x06 -> 0x62
+    LATENCY_FUNCTIONS1_REPLY,   // 0x42 0x20 -> 0x62
+    LATENCY_FUNCTIONS2_REPLY,   // 0x42 0x22 -> 0x62
+    LATENCY_SET_ACK,            // 0x41 -> 0x61
+    LATENCY_COMMAND_PUBLISH,    // control() -> first published state carrying the command
+    LATENCY_KIND_COUNT
+};
+static const char* const LATENCY_NAMES[LATENCY_KIND_COUNT] = {
+    "Settings Reply", "Room Temperature Reply", "Status Reply", "Functions 1 Reply", "Functions 2 Reply",
+    "Set ACK", "Command Publish"
+};
+static const char* LATENCY_SENSORS_INTERVAL_NAME = "hp->latency_sensors"; // name of the scheduler publishing the latency sensors
+static const int LATENCY_SENSORS_INTERVAL_MS = 60000;
+
+/**
+ * protocol health counters, since boot or the last reset_health_counters()
+*/
+enum healthCounter : uint8_t {
+    HEALTH_RX_ACK,                      // 0x61 frames received
+    HEALTH_RX_INFO,                     // 0x62
+    HEALTH_RX_CONNECT,                  // 0x7A
+    HEALTH_TX_SET,                      // 0x41 frames sent
+    HEALTH_TX_INFO,                     // 0x42
+    HEALTH_TX_CONNECT,                  // 0x5A
+    HEALTH_CHECKSUM_ERRORS,             // frames rejected by the frame reader because of their checksum
+    HEALTH_UNKNOWN_DATA_TYPES,          // 0x62 frames of a data type the decoder does not know
+    HEALTH_DEFERRED_WRITES,             // frames which had to wait for room in the UART buffer
+    HEALTH_DROPPED_WRITES,              // frames refused because the TX queue was full
+    HEALTH_FAILED_WRITES,               // frames the transport wrote short or not at all, the link is opened again
+    HEALTH_RECONNECTS_STATUS,           // programResponseCheck(): too many status requests without reply
+    HEALTH_RECONNECTS_ACK,              // buildAndSendRequestsInfoPackets(): the ACK of the wanted settings never came
+    HEALTH_RECONNECTS_INACTIVE,         // the heatpump stopped replying or the transport could not be opened
+    HEALTH_RECONNECTS_NO_REPLY,         // transactionFailed(): requests without reply despite their retransmissions
+    HEALTH_COALESCED_COMMANDS,          // control() calls merged into an already pending set packet
+    HEALTH_SUPPRESSED_PUBLISHES,        // publishes skipped because nothing changed
+    HEALTH_COUNTER_COUNT
+};
+static const char* const HEALTH_COUNTER_NAMES[HEALTH_COUNTER_COUNT] = {
+    "RX ACK Frames", "RX Info Frames", "RX Connect Frames", "TX Set Frames", "TX Info Frames", "TX Connect Frames",
+    "Checksum Errors", "Unknown Data Types", "Deferred Writes", "Dropped Writes", "Failed Writes",
+    "Reconnects Status Timeout", "Reconnects ACK Timeout", "Reconnects Link Inactive", "Reconnects No Reply",
+    "Coalesced Commands", "Suppressed Publishes"
+};
+static const char* HEALTH_SENSORS_INTERVAL_NAME = "hp->health_sensors"; // name of the scheduler publishing the health counters
+static const int HEALTH_SENSORS_INTERVAL_MS = 60000;
+
 
 const uint8_t ESPMHP_MIN_TEMPERATURE = 10;
 const uint8_t ESPMHP_MAX_TEMPERATURE = 31;
 const float ESPMHP_TEMPERATURE_STEP = 0.5;
 
 
-struct heatpumpSettings {
-    const char* power;
-    const char* mode;
-    float temperature;
-    const char* fan;
-    const char* vane; //vertical vane, up/down
-    const char* wideVane; //horizontal vane, left/right
-    bool iSee;   //iSee sensor, at the moment can only detect it, not set it
-    bool connected;
-
-    heatpumpSettings& operator=(const heatpumpSettings& other) {
-        if (this != &other) { // protection contre l'auto-affectation
-            power = other.power;
-            mode = other.mode;
-            temperature = other.temperature;
-            fan = other.fan;
-            vane = other.vane;
-            wideVane = other.wideVane;
-            iSee = other.iSee;
-            connected = other.connected;
-        }
-        return *this;
-    }
-
-
-    bool operator==(const heatpumpSettings& other) const {
-        return power == other.power &&
-            mode == other.mode &&
-            temperature == other.temperature &&
-            fan == other.fan &&
-            vane == other.vane;
-        // && wideVane == other.wideVane &&
-        //iSee == other.iSee;
-    }
-
-    bool operator!=(const heatpumpSettings& other) {
-        return !(this->operator==(other));
-    }
-
-};
-
+// heatpumpSettings, heatpumpStatus and the SETTINGS_FIELD_* mask are defined in cn105Codec.h
 struct wantedHeatpumpSettings : heatpumpSettings {
     bool hasChanged;
     bool hasBeenSent;
     uint8_t nb_deffered_requests;
-    wantedHeatpumpSettings& operator=(const wantedHeatpumpSettings& other) {
-        if (this != &other) { // protection contre l'auto-affectation
-            heatpumpSettings::operator=(other); // Appel à l'opérateur d'affectation de la classe de base
-            hasChanged = other.hasChanged;
-            hasBeenSent = other.hasBeenSent;
-        }
-        return *this;
+    uint8_t dirtyFields;        // SETTINGS_FIELD_* asked by the user and not sent yet
+    uint8_t sentFields;         // SETTINGS_FIELD_* sent and not yet acknowledged by the heatpump
+    heatpumpSettings sentValues;        // their values
+
+    /**
+     * what the heatpump has or is about to have: the values of the set packets not acknowledged
+     * yet, the current ones for the other fields
+    */
+    heatpumpSettings reference(const heatpumpSettings& current) const {
+        heatpumpSettings settings = current;
+        settings.merge(this->sentValues, this->sentFields);
+        return settings;
     }
 
-    wantedHeatpumpSettings& operator=(const heatpumpSettings& other) {
-        if (this != &other) { // protection contre l'auto-affectation
-            heatpumpSettings::operator=(other); // Copie des membres de base                        
+    // records a field asked by the user, it is only sent if it differs from the reference value
+    void markField(uint8_t field, const heatpumpSettings& current) {
+        if (this->differingFields(this->reference(current)) & field) {
+            this->dirtyFields |= field;
+        } else {
+            this->dirtyFields &= ~field;
         }
-        return *this;
     }
-};
 
-struct heatpumpTimers {
-    const char* mode;
-    int onMinutesSet;
-    int onMinutesRemaining;
-    int offMinutesSet;
-    int offMinutesRemaining;
-
-    heatpumpTimers& operator=(const heatpumpTimers& other) {
-        if (this != &other) { // protection contre l'auto-affectation
-            mode = other.mode;
-            onMinutesSet = other.onMinutesSet;
-            onMinutesRemaining = other.onMinutesRemaining;
-            offMinutesSet = other.offMinutesSet;
-            offMinutesRemaining = other.offMinutesRemaining;
-        }
-        return *this;
+    // the dirty fields are given to a set packet
+    void markSent() {
+        this->sentValues.merge(*this, this->dirtyFields);
+        this->sentFields |= this->dirtyFields;
+        this->dirtyFields = 0;
+        this->hasBeenSent = true;
     }
-    bool operator==(const heatpumpTimers& other) const {
-        return
-            mode == other.mode &&
-            onMinutesSet == other.onMinutesSet &&
-            onMinutesRemaining == other.onMinutesRemaining &&
-            offMinutesSet == other.offMinutesSet &&
-            offMinutesRemaining == other.offMinutesRemaining;
-    }
-
 
-    bool operator!=(const heatpumpTimers& other) const {
-        return !(this->operator==(other));
+    // a set packet has been acknowledged: its fields are applied unless a later packet carries another value
+    void acknowledge(const heatpumpSettings& values, uint8_t fields) {
+        this->sentFields &= ~(fields & ~this->sentValues.differingFields(values));
+        this->settle();
     }
-};
 
+    // the set packets carrying fields are lost: the ones which still differ are sent again
+    void sendAgain(uint8_t fields, const heatpumpSettings& current) {
+        fields &= this->sentFields;
+        this->dirtyFields |= fields & this->differingFields(current);
+        this->sentFields &= ~fields;
+        this->hasBeenSent = false;
+        this->settle();
+    }
 
-struct heatpumpStatus {
-    float roomTemperature;
-    bool operating; // if true, the heatpump is operating to reach the desired temperature
-    heatpumpTimers timers;
-    int compressorFrequency;
-
-    bool operator==(const heatpumpStatus& other) const {
-        return roomTemperature == other.roomTemperature &&
-            operating == other.operating &&
-            timers == other.timers &&  // Assurez-vous que l'opérateur == est également défini pour heatpumpTimers
-            compressorFrequency == other.compressorFrequency;
+    // nothing left to send nor to wait for: the polls can go on
+    void settle() {
+        this->hasChanged = (this->dirtyFields | this->sentFields) != 0;
+        if (!this->hasChanged) {
+            this->hasBeenSent = false;
+            this->nb_deffered_requests = 0;
+        }
     }
 
-    bool operator!=(const heatpumpStatus& other) const {
-        return !(*this == other);
+    wantedHeatpumpSettings& operator=(const heatpumpSettings& other) {
+        heatpumpSettings::operator=(other); // Copie des membres de base
+        return *this;
     }
 };
+
+/**
+ * replies received during a poll cycle: they are applied all at once when the cycle is over,
+ * so HA never sees a state mixing the values of two cycles
+*/
+struct heatpumpSnapshot {
+    heatpumpSettings settings;
+    heatpumpStatus status;          // starts as a copy of currentStatus, each reply updates its own fields
+    bool hasSettings = false;
+    bool hasStatus = false;
+    uint64_t startedMs = 0;
+};
@@ -2,12 +2,14 @@ import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import climate, uart
 from esphome.components import select
-from esphome.components.logger import HARDWARE_UART_TO_SERIAL
+from esphome.components.logger import HARDWARE_UART_TO_SERIAL, LOG_LEVELS, is_log_level
 
 from esphome.const import (
     CONF_ID,
     CONF_HARDWARE_UART,
     CONF_BAUD_RATE,
+    CONF_HOST,
+    CONF_PORT,
     CONF_UPDATE_INTERVAL,
     CONF_MODE,
     CONF_FAN_MODE,
@@ -25,10 +27,51 @@ DEFAULT_SWING_MODES = ["OFF", "VERTICAL", "HORIZONTAL", "BOTH"]
 # Déclaration des constantes pour TX et RX pin
 CONF_TX_PIN = "tx_pin"
 CONF_RX_PIN = "rx_pin"
+CONF_COMMAND_COALESCING_WINDOW = "command_coalescing_window"
+CONF_MIN_UPDATE_INTERVAL = "min_update_interval"
+CONF_MAX_UPDATE_INTERVAL = "max_update_interval"
+CONF_POLL_PERIODS = "poll_periods"
+CONF_PUBLISH_FILTERS = "publish_filters"
+CONF_CURRENT_TEMPERATURE = "current_temperature"
+CONF_COMPRESSOR_FREQUENCY = "compressor_frequency"
+CONF_DEADBAND = "deadband"
+CONF_MIN_INTERVAL = "min_interval"
+CONF_LOG_LEVELS = "log_levels"
+CONF_TCP_BRIDGE = "tcp_bridge"
+CONF_LATENCY_SENSORS = "latency_sensors"
+CONF_HEALTH_SENSORS = "health_sensors"
+CONF_SNAPSHOT_AGE_SENSOR = "snapshot_age_sensor"
+
+# logSubsystem values, their level can also be changed at runtime with set_log_level()
+LOG_SUBSYSTEMS = {
+    "decoder": 0,
+    "writer": 1,
+    "settings": 2,
+}
+
+# request types which can be polled (RQST_PKT_* index in INFOMODE)
+# their period defaults to each poll cycle for settings, room_temperature and status, never for the others
+POLL_PERIOD_TYPES = {
+    "settings": 0,
+    "room_temperature": 1,
+    "timers": 3,
+    "status": 4,
+    "standby": 5,
+}
 
 CN105Climate = cg.global_ns.class_("CN105Climate", climate.Climate, cg.PollingComponent)
 
 
+PUBLISH_FILTER_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_DEADBAND, default=0): cv.positive_float,
+        cv.Optional(
+            CONF_MIN_INTERVAL, default="0s"
+        ): cv.positive_time_period_milliseconds,
+    }
+)
+
+
 def valid_uart(uart):
     if CORE.is_esp8266:
         uarts = ["UART0"]  # UART1 is tx-only
@@ -40,14 +83,79 @@ def valid_uart(uart):
     return cv.one_of(*uarts, upper=True)(uart)
 
 
-CONFIG_SCHEMA = climate.CLIMATE_SCHEMA.extend(
+def validate_update_intervals(config):
+    # nextPollInterval() clamps to min_update_interval then to max_update_interval
+    update_interval = config[CONF_UPDATE_INTERVAL]
+    if not isinstance(update_interval, int):  # "never" is already a number of ms
+        update_interval = update_interval.total_milliseconds
+    min_interval = config.get(CONF_MIN_UPDATE_INTERVAL)
+    max_interval = config.get(CONF_MAX_UPDATE_INTERVAL)
+    if min_interval is None and max_interval is None:
+        return config
+    if update_interval == 0:
+        raise cv.Invalid(
+            f"{CONF_MIN_UPDATE_INTERVAL} and {CONF_MAX_UPDATE_INTERVAL} need an {CONF_UPDATE_INTERVAL}"
+        )
+    if min_interval is not None and min_interval.total_milliseconds > update_interval:
+        raise cv.Invalid(
+            f"{CONF_MIN_UPDATE_INTERVAL} must not be longer than {CONF_UPDATE_INTERVAL}",
+            [CONF_MIN_UPDATE_INTERVAL],
+        )
+    if max_interval is not None and max_interval.total_milliseconds < update_interval:
+        raise cv.Invalid(
+            f"{CONF_MAX_UPDATE_INTERVAL} must not be shorter than {CONF_UPDATE_INTERVAL}",
+            [CONF_MAX_UPDATE_INTERVAL],
+        )
+    if max_interval is not None and max_interval.total_milliseconds > 0xFFFFFFFF:
+        raise cv.Invalid(
+            f"{CONF_MAX_UPDATE_INTERVAL} must be shorter than 49 days",
+            [CONF_MAX_UPDATE_INTERVAL],
+        )
+    return config
+
+
+CN105_SCHEMA = climate.CLIMATE_SCHEMA.extend(
     {
         cv.GenerateID(): cv.declare_id(CN105Climate),
         cv.Optional(CONF_HARDWARE_UART, default="UART0"): valid_uart,
         cv.Optional(CONF_BAUD_RATE): cv.positive_int,
         cv.Optional(CONF_TX_PIN): cv.positive_int,
         cv.Optional(CONF_RX_PIN): cv.positive_int,
+        # the heatpump is reached through a serial-over-network bridge (2400 bauds 8E1) instead of the UART
+        cv.Optional(CONF_TCP_BRIDGE): cv.Schema(
+            {
+                cv.Required(CONF_HOST): cv.string_strict,
+                cv.Required(CONF_PORT): cv.port,
+            }
+        ),
         cv.Optional(CONF_UPDATE_INTERVAL, default="0ms"): cv.All(cv.update_interval),
+        # bounds of the adaptive poll interval, update_interval if not set: min <= update_interval <= max
+        cv.Optional(CONF_MIN_UPDATE_INTERVAL): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_MAX_UPDATE_INTERVAL): cv.positive_time_period_milliseconds,
+        # values are only published when they changed by at least deadband, at most once per min_interval
+        cv.Optional(CONF_PUBLISH_FILTERS, default={}): cv.Schema(
+            {
+                cv.Optional(CONF_CURRENT_TEMPERATURE, default={}): PUBLISH_FILTER_SCHEMA,
+                cv.Optional(CONF_COMPRESSOR_FREQUENCY, default={}): PUBLISH_FILTER_SCHEMA,
+            }
+        ),
+        # log level of the component subsystems, the logger level by default: lower it to narrow the output
+        cv.Optional(CONF_LOG_LEVELS, default={}): cv.Schema(
+            {cv.Optional(name): is_log_level for name in LOG_SUBSYSTEMS}
+        ),
+        # period of each request type: 0s polls it at each cycle, never disables it
+        cv.Optional(CONF_POLL_PERIODS, default={}): cv.Schema(
+            {cv.Optional(name): cv.update_interval for name in POLL_PERIOD_TYPES}
+        ),
+        cv.Optional(
+            CONF_COMMAND_COALESCING_WINDOW, default="300ms"
+        ): cv.positive_time_period_milliseconds,
+        # p50 / p95 / max diagnostic sensors of the reply, ACK and command latencies
+        cv.Optional(CONF_LATENCY_SENSORS, default=False): cv.boolean,
+        # frames, errors and reconnections counters as diagnostic sensors, see reset_health_counters()
+        cv.Optional(CONF_HEALTH_SENSORS, default=False): cv.boolean,
+        # age of the data when a poll cycle starts, as a diagnostic sensor
+        cv.Optional(CONF_SNAPSHOT_AGE_SENSOR, default=False): cv.boolean,
         # Optionally override the supported ClimateTraits.
         cv.Optional(CONF_SUPPORTS, default={}): cv.Schema(
             {
@@ -65,6 +173,8 @@ CONFIG_SCHEMA = climate.CLIMATE_SCHEMA.extend(
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
+CONFIG_SCHEMA = cv.All(CN105_SCHEMA, validate_update_intervals)
+
 
 @coroutine
 def to_code(config):
@@ -80,6 +190,56 @@ def to_code(config):
         rx_pin = config[CONF_RX_PIN]
         cg.add(var.set_tx_rx_pins(tx_pin, rx_pin))
 
+    if CONF_TCP_BRIDGE in config:
+        bridge = config[CONF_TCP_BRIDGE]
+        cg.add(var.set_tcp_bridge(bridge[CONF_HOST], bridge[CONF_PORT]))
+
+    cg.add(
+        var.set_command_coalescing_window(
+            config[CONF_COMMAND_COALESCING_WINDOW].total_milliseconds
+        )
+    )
+
+    if CONF_MIN_UPDATE_INTERVAL in config:
+        cg.add(
+            var.set_min_update_interval(
+                config[CONF_MIN_UPDATE_INTERVAL].total_milliseconds
+            )
+        )
+    if CONF_MAX_UPDATE_INTERVAL in config:
+        cg.add(
+            var.set_max_update_interval(
+                config[CONF_MAX_UPDATE_INTERVAL].total_milliseconds
+            )
+        )
+
+    for name, period in config[CONF_POLL_PERIODS].items():
+        cg.add(var.set_poll_period(POLL_PERIOD_TYPES[name], period))
+
+    filters = config[CONF_PUBLISH_FILTERS]
+    cg.add(
+        var.set_current_temperature_publish_filter(
+            filters[CONF_CURRENT_TEMPERATURE][CONF_DEADBAND],
+            filters[CONF_CURRENT_TEMPERATURE][CONF_MIN_INTERVAL],
+        )
+    )
+    cg.add(
+        var.set_compressor_frequency_publish_filter(
+            filters[CONF_COMPRESSOR_FREQUENCY][CONF_DEADBAND],
+            filters[CONF_COMPRESSOR_FREQUENCY][CONF_MIN_INTERVAL],
+        )
+    )
+
+    if config[CONF_LATENCY_SENSORS]:
+        cg.add(var.set_latency_sensors(True))
+    if config[CONF_HEALTH_SENSORS]:
+        cg.add(var.set_health_sensors(True))
+    if config[CONF_SNAPSHOT_AGE_SENSOR]:
+        cg.add(var.set_snapshot_age_sensor(True))
+
+    for name, level in config[CONF_LOG_LEVELS].items():
+        cg.add(var.set_log_level(LOG_SUBSYSTEMS[name], LOG_LEVELS[level]))
+
     supports = config[CONF_SUPPORTS]
     traits = var.config_traits()
 
@@ -9,26 +9,60 @@ void CN105Climate::checkPendingWantedSettings() {
     if (this->firstRun) {
         return;
     }
-    if (this->currentSettings != this->wantedSettings) {
+    if (this->wantedSettings.dirtyFields != 0) {
+        if (this->clock->nowMs() - this->lastControlMs < this->coalescingWindowMs) {
+            // the user is still changing things (e.g. dragging the HA slider): wait for the burst to end
+            return;
+        }
+        ESP_LOGD(TAG, "checkPendingWantedSettings - wanted settings have changed, sending them to the heatpump...");
+        this->sendWantedSettings();
+    } else if (!this->wantedSettings.hasChanged && this->currentSettings != this->wantedSettings) {
+        ESP_LOGI(TAG, "checkPendingWantedSettings - detected a change from IR Remote Control");
+        // if not wantedSettings.hasChanged this is because we've had a change from IR Remote Control
+
+        // TODO: this shouldn't be necessary here
+        this->wantedSettings = this->currentSettings;
+        this->wantedSettings.hasChanged = false;
+        this->wantedSettings.hasBeenSent = false;
+        this->wantedSettings.dirtyFields = 0;
+        this->wantedSettings.sentFields = 0;
+    }
+
+}
 
-        if (this->wantedSettings.hasChanged) {
-            if (!this->wantedSettings.hasBeenSent) {
-                ESP_LOGD(TAG, "checkPendingWantedSettings - wanted settings have changed, sending them to the heatpump...");
-                this->sendWantedSettings();
-                this->set_timeout("checkWantedSettings", 1000, [this]() { this->wantedSettings.hasBeenSent = false; });
+/**
+ * called after the setters: a set packet is only needed if one of the asked fields
+ * differs from what the heatpump has or is about to have
+*/
+void CN105Climate::wantedSettingsChanged() {
+    this->lastControlMs = this->clock->nowMs();
+
+    if (this->wantedSettings.dirtyFields != 0) {
+        if (this->pendingCommands > 0) {
+            // the set packet is still waiting for the end of the coalescing window: it will carry this change too
+            this->health[HEALTH_COALESCED_COMMANDS]++;
+        }
+        this->pendingCommands++;
+        if (this->commandStartedMs == 0) {
+            this->commandStartedMs = this->lastControlMs;
+        }
+        this->wantedSettings.hasChanged = true;
+        this->wantedSettings.hasBeenSent = false;
+        this->pollActivity("user command");
+    } else {
+        CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "asked settings are already the current ones, nothing to send");
+        if (this->pendingCommands > 0) {
+            // set back to its previous value within the coalescing window: the pending set packet has nothing left to carry
+            ESP_LOGI(TAG, "pending command cancelled by the next one (%" PRIu32 " control calls)", this->pendingCommands + 1);
+            this->health[HEALTH_COALESCED_COMMANDS]++;
+            this->pendingCommands = 0;
+            if (this->wantedSettings.sentFields == 0) {
+                this->commandStartedMs = 0;     // no state will carry it
             }
-        } else {
-            ESP_LOGI(TAG, "checkPendingWantedSettings - detected a change from IR Remote Control");
-            // if not wantedSettings.hasChanged this is because we've had a change from IR Remote Control
-
-            // TODO: this shouldn't be necessary here
-            this->wantedSettings = this->currentSettings;
-            this->wantedSettings.hasChanged = false;
-            this->wantedSettings.hasBeenSent = false;
         }
-
+        // only a set packet in flight is still waited for
+        this->wantedSettings.settle();
     }
-
 }
 
 //#region climate
@@ -71,9 +105,8 @@ void CN105Climate::control(const esphome::climate::ClimateCall& call) {
 
 
     if (updated) {
-        ESP_LOGD(LOG_ACTION_EVT_TAG, "clim.control() -> User changed something...");
-        this->wantedSettings.hasChanged = true;
-        this->wantedSettings.hasBeenSent = false;
+        CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "clim.control() -> User changed something...");
+        this->wantedSettingsChanged();
         this->debugSettings("control (wantedSettings)", this->wantedSettings);
 
         // we don't call sendWantedSettings() anymore because it will be called by the loop() method
@@ -89,21 +122,21 @@ void CN105Climate::control(const esphome::climate::ClimateCall& call) {
 void CN105Climate::controlSwing() {
     switch (this->swing_mode) {
     case climate::CLIMATE_SWING_OFF:
-        this->setVaneSetting("AUTO");
+        this->setVaneSetting(HP_VANE_AUTO);
         //setVaneSetting supports:  AUTO 1 2 3 4 5 and SWING
-        //this->setWideVaneSetting("|");
+        //this->setWideVaneSetting(HP_WIDEVANE_CENTER);
         break;
     case climate::CLIMATE_SWING_VERTICAL:
-        this->setVaneSetting("SWING");
-        //this->setWideVaneSetting("|");
+        this->setVaneSetting(HP_VANE_SWING);
+        //this->setWideVaneSetting(HP_WIDEVANE_CENTER);
         break;
     case climate::CLIMATE_SWING_HORIZONTAL:
-        this->setVaneSetting("3");
-        this->setWideVaneSetting("SWING");
+        this->setVaneSetting(HP_VANE_3);
+        this->setWideVaneSetting(HP_WIDEVANE_SWING);
         break;
     case climate::CLIMATE_SWING_BOTH:
-        this->setVaneSetting("SWING");
-        this->setWideVaneSetting("SWING");
+        this->setVaneSetting(HP_VANE_SWING);
+        this->setWideVaneSetting(HP_WIDEVANE_SWING);
         break;
     default:
         ESP_LOGW(TAG, "control - received unsupported swing mode request.");
@@ -113,30 +146,30 @@ void CN105Climate::controlFan() {
 
     switch (this->fan_mode.value()) {
     case climate::CLIMATE_FAN_OFF:
-        this->setPowerSetting("OFF");
+        this->setPowerSetting(HP_POWER_OFF);
         break;
     case climate::CLIMATE_FAN_QUIET:
-        this->setFanSpeed("QUIET");
+        this->setFanSpeed(HP_FAN_QUIET);
         break;
     case climate::CLIMATE_FAN_DIFFUSE:
-        this->setFanSpeed("QUIET");
+        this->setFanSpeed(HP_FAN_QUIET);
         break;
     case climate::CLIMATE_FAN_LOW:
-        this->setFanSpeed("1");
+        this->setFanSpeed(HP_FAN_1);
         break;
     case climate::CLIMATE_FAN_MEDIUM:
-        this->setFanSpeed("2");
+        this->setFanSpeed(HP_FAN_2);
         break;
     case climate::CLIMATE_FAN_MIDDLE:
-        this->setFanSpeed("3");
+        this->setFanSpeed(HP_FAN_3);
         break;
     case climate::CLIMATE_FAN_HIGH:
-        this->setFanSpeed("4");
+        this->setFanSpeed(HP_FAN_4);
         break;
     case climate::CLIMATE_FAN_ON:
     case climate::CLIMATE_FAN_AUTO:
     default:
-        this->setFanSpeed("AUTO");
+        this->setFanSpeed(HP_FAN_AUTO);
         break;
     }
 }
@@ -144,13 +177,14 @@ void CN105Climate::controlTemperature() {
     float setting = this->target_temperature;
 
     if (!this->tempMode) {
-        this->wantedSettings.temperature = this->lookupByteMapIndex(TEMP_MAP, 16, (int)(setting + 0.5)) > -1 ? setting : TEMP_MAP[0];
+        this->wantedSettings.setTemperature(this->lookupByteMapIndex(TEMP_MAP, (int)(setting + 0.5)) > -1 ? setting : TEMP_MAP.valueAt(0));
     } else {
         setting = setting * 2;
         setting = round(setting);
         setting = setting / 2;
-        this->wantedSettings.temperature = setting < 10 ? 10 : (setting > 31 ? 31 : setting);
+        this->wantedSettings.setTemperature(setting < 10 ? 10 : (setting > 31 ? 31 : setting));
     }
+    this->wantedSettings.markField(SETTINGS_FIELD_TEMP, this->currentSettings);
 }
 
 
@@ -158,32 +192,32 @@ void CN105Climate::controlMode() {
     switch (this->mode) {
     case climate::CLIMATE_MODE_COOL:
         ESP_LOGI("control", "changing mode to COOL");
-        this->setModeSetting("COOL");
-        this->setPowerSetting("ON");
+        this->setModeSetting(HP_MODE_COOL);
+        this->setPowerSetting(HP_POWER_ON);
         break;
     case climate::CLIMATE_MODE_HEAT:
         ESP_LOGI("control", "changing mode to HEAT");
-        this->setModeSetting("HEAT");
-        this->setPowerSetting("ON");
+        this->setModeSetting(HP_MODE_HEAT);
+        this->setPowerSetting(HP_POWER_ON);
         break;
     case climate::CLIMATE_MODE_DRY:
         ESP_LOGI("control", "changing mode to DRY");
-        this->setModeSetting("DRY");
-        this->setPowerSetting("ON");
+        this->setModeSetting(HP_MODE_DRY);
+        this->setPowerSetting(HP_POWER_ON);
         break;
     case climate::CLIMATE_MODE_HEAT_COOL:
         ESP_LOGI("control", "changing mode to HEAT_COOL");
-        this->setModeSetting("AUTO");
-        this->setPowerSetting("ON");
+        this->setModeSetting(HP_MODE_AUTO);
+        this->setPowerSetting(HP_POWER_ON);
         break;
     case climate::CLIMATE_MODE_FAN_ONLY:
         ESP_LOGI("control", "changing mode to FAN_ONLY");
-        this->setModeSetting("FAN");
-        this->setPowerSetting("ON");
+        this->setModeSetting(HP_MODE_FAN);
+        this->setPowerSetting(HP_POWER_ON);
         break;
     case climate::CLIMATE_MODE_OFF:
         ESP_LOGI("control", "changing mode to OFF");
-        this->setPowerSetting("OFF");
+        this->setPowerSetting(HP_POWER_OFF);
         break;
     default:
         ESP_LOGW("control", "mode non pris en charge");
@@ -262,51 +296,37 @@ climate::ClimateTraits& CN105Climate::config_traits() {
 }
 
 
-void CN105Climate::setModeSetting(const char* setting) {
-    int index = lookupByteMapIndex(MODE_MAP, 5, setting);
-    if (index > -1) {
-        wantedSettings.mode = MODE_MAP[index];
-    } else {
-        wantedSettings.mode = MODE_MAP[0];
-    }
+void CN105Climate::setModeSetting(hpMode setting) {
+    wantedSettings.mode = setting;
+    wantedSettings.markField(SETTINGS_FIELD_MODE, currentSettings);
 }
 
-void CN105Climate::setPowerSetting(const char* setting) {
-    int index = lookupByteMapIndex(POWER_MAP, 2, setting);
-    if (index > -1) {
-        wantedSettings.power = POWER_MAP[index];
-    } else {
-        wantedSettings.power = POWER_MAP[0];
-    }
+void CN105Climate::setPowerSetting(hpPower setting) {
+    wantedSettings.power = setting;
+    wantedSettings.markField(SETTINGS_FIELD_POWER, currentSettings);
 }
 
-void CN105Climate::setFanSpeed(const char* setting) {
-    int index = lookupByteMapIndex(FAN_MAP, 6, setting);
-    if (index > -1) {
-        wantedSettings.fan = FAN_MAP[index];
-    } else {
-        wantedSettings.fan = FAN_MAP[0];
-    }
+void CN105Climate::setFanSpeed(hpFan setting) {
+    wantedSettings.fan = setting;
+    wantedSettings.markField(SETTINGS_FIELD_FAN, currentSettings);
 }
 
-void CN105Climate::setVaneSetting(const char* setting) {
-    int index = lookupByteMapIndex(VANE_MAP, 7, setting);
-    if (index > -1) {
-        wantedSettings.vane = VANE_MAP[index];
-    } else {
-        wantedSettings.vane = VANE_MAP[0];
-    }
+void CN105Climate::setVaneSetting(hpVane setting) {
+    wantedSettings.vane = setting;
+    wantedSettings.markField(SETTINGS_FIELD_VANE, currentSettings);
 }
 
-void CN105Climate::setWideVaneSetting(const char* setting) {
-    int index = lookupByteMapIndex(WIDEVANE_MAP, 7, setting);
+// used by the vane select component which works with the VANE_MAP names
+void CN105Climate::setVaneSetting(const char* setting) {
+    int index = lookupByteMapIndex(VANE_MAP, setting);
     if (index > -1) {
-        wantedSettings.wideVane = WIDEVANE_MAP[index];
+        this->setVaneSetting((hpVane)index);
     } else {
-        wantedSettings.wideVane = WIDEVANE_MAP[0];
+        this->setVaneSetting(HP_VANE_AUTO);
     }
 }
 
-
-
-
+void CN105Climate::setWideVaneSetting(hpWideVane setting) {
+    wantedSettings.wideVane = setting;
+    wantedSettings.markField(SETTINGS_FIELD_WIDEVANE, currentSettings);
+}
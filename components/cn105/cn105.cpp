@@ -2,12 +2,13 @@
 // TODO: instead of having to entry points, control and update, we should only record control modifications and run them in the nexte update call
 
 #include "cn105.h"
+#include "tcpTransport.h"
 
 using namespace esphome;
 
 
 CN105Climate::CN105Climate(HardwareSerial* hw_serial)
-    : hw_serial_(hw_serial) {
+    : hw_serial_(hw_serial), uart(hw_serial), transport(&uart), clock(&espClock) {
     this->traits_.set_supports_action(true);
     this->traits_.set_supports_current_temperature(true);
     this->traits_.set_supports_two_point_target_temperature(false);
@@ -49,9 +50,14 @@ CN105Climate::CN105Climate(HardwareSerial* hw_serial)
     this->lastSend = 0;
     this->infoMode = 0;
     this->currentStatus.operating = false;
-    this->currentStatus.compressorFrequency = -1;
+    this->currentStatus.compressorFrequency = 0;
     this->tx_pin_ = -1;
     this->rx_pin_ = -1;
+    for (int i = 0; i < INFOMODE_LEN; i++) {
+        this->pollPeriodsMs[i] = DEFAULT_POLL_PERIODS[i];
+        this->lastPolledMs[i] = 0;
+        this->polledOnce[i] = false;
+    }
 
     generateExtraComponents();
 
@@ -68,14 +74,29 @@ void CN105Climate::set_baud_rate(int baud) {
 void CN105Climate::set_tx_rx_pins(uint8_t tx_pin, uint8_t rx_pin) {
     this->tx_pin_ = tx_pin;
     this->rx_pin_ = rx_pin;
+    this->uart.setPins(tx_pin, rx_pin);
     ESP_LOGI(TAG, "setting tx_pin: %d rx_pin: %d", tx_pin, rx_pin);
 
 }
 
+void CN105Climate::set_transport(cn105Transport* transport) {
+    this->transport = transport;
+    ESP_LOGI(TAG, "using the %s transport", transport->name());
+}
+
+void CN105Climate::set_clock(cn105Clock* clock) {
+    this->clock = clock;
+}
+
+void CN105Climate::set_tcp_bridge(const std::string& host, uint16_t port) {
+    ESP_LOGI(TAG, "heatpump reached through the serial bridge %s:%d", host.c_str(), port);
+    this->set_transport(new tcpTransport(host, port));
+}
+
 
 void CN105Climate::check_logger_conflict_() {
 #ifdef USE_LOGGER
-    if (this->get_hw_serial_() == logger::global_logger->get_hw_serial()) {
+    if (this->transport == &this->uart && this->get_hw_serial_() == logger::global_logger->get_hw_serial()) {
         ESP_LOGW(TAG, "  You're using the same serial port for logging"
             " and the MitsubishiHeatPump component. Please disable"
             " logging over the serial port by setting"
@@ -116,29 +137,23 @@ void CN105Climate::setupUART() {
 
     this->uart_setup_switch = true;
 
-    if (this->get_hw_serial_() != NULL) {
-        ESP_LOGD(TAG, "Serial->begin...");
+    if (this->transport != nullptr) {
+        ESP_LOGD(TAG, "%s->begin...", this->transport->name());
 
-        if (this->tx_pin_ != -1 && this->rx_pin_ != -1) {
+        if (this->transport == &this->uart && this->tx_pin_ != -1 && this->rx_pin_ != -1) {
             // Initialisation de l'UART avec les broches spécifiées
             ESP_LOGI(TAG, "Initialisation de l'UART avec les broches %d et %d...", this->tx_pin_, this->rx_pin_);
-
-#ifdef ESP8266
-            this->get_hw_serial_()->begin(this->baud_, SERIAL_8E1);
-            this->get_hw_serial_()->pins(this->tx_pin_, this->rx_pin_);
-#elif defined(ESP32)
-            // Code spécifique à l'ESP32
-            // (Configuration appropriée pour l'ESP32)
-            this->get_hw_serial_()->begin(this->baud_, SERIAL_8E1, this->rx_pin_, this->tx_pin_);
-#endif
-        } else {
+        } else if (this->transport == &this->uart) {
             // Initialisation de l'UART avec les broches par défaut
             ESP_LOGI(TAG, "Initialisation de l'UART avec les broches par défaut");
-            this->get_hw_serial_()->begin(this->baud_, SERIAL_8E1);
         }
 
-        this->isConnected_ = true;
-        this->initBytePointer();
+        if (this->transport->begin(this->baud_)) {
+            this->isConnected_ = true;
+            this->initBytePointer();
+        } else {
+            ESP_LOGE(TAG, "%s could not be opened", this->transport->name());
+        }
     } else {
         ESP_LOGE(TAG, "L'UART doit être défini.");
     }
@@ -154,9 +169,10 @@ void CN105Climate::disconnectUART() {
     this->isHeatpumpConnected_ = false;
     this->isConnected_ = false;
     this->cancel_timeout(SHEDULER_INTERVAL_SYNC_NAME);
+    this->cancelPollCycle();
     this->publish_state();
-    if (this->get_hw_serial_() != NULL) {
-        this->get_hw_serial_()->end();
+    if (this->transport != nullptr) {
+        this->transport->end();
     } else {
         ESP_LOGE(TAG, "L'UART doit être défini.");
     }
@@ -169,14 +185,40 @@ void CN105Climate::reconnectUART() {
     this->sendFirstConnectionPacket();
 }
 
+/**
+ * the heatpump only speaks when it is asked: it is still there if it replied during the last poll
+ * interval plus the time MAX_FAILED_TRANSACTIONS requests take to fail at its round trip time
+ * it is not before it has replied to the connect packet of the UART opened last
+*/
 bool CN105Climate::isHeatpumpConnectionActive() {
-    long lrTimeMs = CUSTOM_MILLIS - this->lastResponseMs;
+    if (!this->isConnected_ || !this->isHeatpumpConnected_) {
+        return false;
+    }
+    uint64_t lrTimeMs = this->clock->nowMs() - this->lastResponseMs;
+    uint64_t limitMs = this->pollIntervalMs +
+        (uint64_t)MAX_FAILED_TRANSACTIONS * this->roundTripTimes.overall().budgetMs(TX_MAX_RETRIES);
 
-    if (lrTimeMs > MAX_DELAY_RESPONSE_FACTOR * this->update_interval_) {
-        ESP_LOGW(TAG, "Heatpump has not replied for %d s", lrTimeMs / 1000);
+    if (lrTimeMs > limitMs) {
+        ESP_LOGW(TAG, "Heatpump has not replied for %" PRIu32 " s", (uint32_t)(lrTimeMs / 1000));
         ESP_LOGI(TAG, "We think Heatpump is not connected anymore..");
     }
 
-    return  (lrTimeMs < MAX_DELAY_RESPONSE_FACTOR * this->update_interval_);
+    return  (lrTimeMs < limitMs);
+}
+
+uint32_t CN105Climate::wireTimeUs(size_t length) {
+    return this->baud_ > 0 ? (uint32_t)(length * 11000000ULL / this->baud_) : 0;
+}
+
+uint32_t CN105Climate::replyBudgetMs(uint8_t command, uint8_t type) {
+    return this->roundTripTimes.of(command, type).budgetMs(TX_MAX_RETRIES);
+}
+
+const rttTable& CN105Climate::get_round_trip_times() const {
+    return this->roundTripTimes;
+}
+
+const txQueueStats& CN105Climate::get_tx_queue_stats() const {
+    return this->txQueue.getStats();
 }
 
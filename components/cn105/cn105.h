@@ -1,6 +1,8 @@
 #pragma once
 #include "Globals.h"
 #include "heatpumpFunctions.h"
+#include "uartTransport.h"
+#include "systemClock.h"
 
 using namespace esphome;
 
@@ -18,6 +20,9 @@ public:
 
 
     sensor::Sensor* compressor_frequency_sensor;
+    sensor::Sensor* snapshot_age_sensor = nullptr;                 // see set_snapshot_age_sensor()
+    sensor::Sensor* latency_sensors[LATENCY_KIND_COUNT][3] = {};   // p50, p95, max of each latencyKind, see set_latency_sensors()
+    sensor::Sensor* health_sensors[HEALTH_COUNTER_COUNT] = {};     // see set_health_sensors()
     binary_sensor::BinarySensor* iSee_sensor;
     select::Select* vane;
 
@@ -27,10 +32,6 @@ public:
     int get_compressor_frequency();
     bool is_operating();
 
-    // checks if the field has changed
-    bool hasChanged(const char* before, const char* now, const char* field, bool checkNotNull = false);
-    bool isWantedSettingApplied(const char* wantedSettingProp, const char* currentSettingProp, const char* field);
-
     float get_setup_priority() const override {
         return setup_priority::AFTER_WIFI;  // Configurez ce composant après le WiFi
     }
@@ -44,13 +45,28 @@ public:
     void loop() override;
     void set_baud_rate(int baud_rate);
     void set_tx_rx_pins(uint8_t tx_pin, uint8_t rx_pin);
+    // replaces the hardware UART, transport must outlive the component
+    void set_transport(cn105Transport* transport);
+    void set_tcp_bridge(const std::string& host, uint16_t port);
+    // replaces the clock of the ESP, e.g. by a virtualClock on a host; clock must outlive the component
+    void set_clock(cn105Clock* clock);
+    // next time loop() has something to do which is not driven by a timeout, UINT64_MAX if none
+    // a host with a virtual clock may jump to min(this, the next timeout, the next received byte)
+    uint64_t next_loop_deadline_ms();
     //void set_wifi_connected_state(bool state);
     void setupUART();
     void disconnectUART();
     void reconnectUART();
     void buildAndSendRequestsInfoPackets();
     void buildAndSendRequestPacket(int packetType);
+    void sendNextPollRequest();
+    void pollReplyReceived(uint8_t infoType);
+    void cancelPollCycle();
     bool isHeatpumpConnectionActive();
+    // time the line takes to carry length bytes (8E1: 11 bits per byte)
+    uint32_t wireTimeUs(size_t length);
+    // how long a request of this kind can stay without reply, retransmissions included
+    uint32_t replyBudgetMs(uint8_t command, uint8_t type);
     // will check if hp did respond
     void programResponseCheck(int packetType);
 
@@ -61,6 +77,53 @@ public:
 
     uint32_t get_update_interval() const;
     void set_update_interval(uint32_t update_interval);
+    // bounds of the adaptive poll interval, 0 means update_interval
+    void set_min_update_interval(uint32_t min_update_interval);
+    void set_max_update_interval(uint32_t max_update_interval);
+    // interval currently programmed between two poll cycles, between the bounds above
+    uint32_t get_poll_interval() const;
+    // period of a request type (RQST_PKT_*), POLL_PERIOD_EVERY_CYCLE or POLL_PERIOD_NEVER
+    void set_poll_period(int packetType, uint32_t period_ms);
+
+    // control() calls received within this window are sent to the heatpump in a single set packet
+    void set_command_coalescing_window(uint32_t window_ms);
+    // number of control() calls which have been merged into an already pending set packet
+    uint32_t get_coalesced_commands() const;
+
+    // publication to HA of the measured values: minimum change and minimum interval between two publishes
+    void set_current_temperature_publish_filter(float deadband, uint32_t min_interval_ms);
+    void set_compressor_frequency_publish_filter(float deadband, uint32_t min_interval_ms);
+    // number of publishes skipped because nothing changed
+    uint32_t get_suppressed_publishes() const;
+
+    // runtime log level (ESPHOME_LOG_LEVEL_*) of a logSubsystem
+    void set_log_level(uint8_t subsystem, uint8_t level);
+
+    // logs the packet trace, it can be called from a lambda of an api service or of a button
+    // the dump can be decoded with tools/trace_replay.cpp
+    void dump_packet_trace();
+    void clear_packet_trace();
+
+    // round trip estimates of the exchanges with the heatpump, from which the reply timeouts are derived
+    const rttTable& get_round_trip_times() const;
+    const txQueueStats& get_tx_queue_stats() const;
+
+    // creates the diagnostic sensor of the age of the data when a poll cycle starts: it grows if the
+    // poll cycles stop completing
+    void set_snapshot_age_sensor(bool enabled);
+
+    // creates the p50 / p95 / max diagnostic sensors of each latencyKind, published every LATENCY_SENSORS_INTERVAL_MS
+    void set_latency_sensors(bool enabled);
+    // logs the latency histograms, it can be called from a lambda of an api service or of a button
+    void dump_latency_histograms();
+    void clear_latency_histograms();
+    const latencyHistogram& get_latency_histogram(latencyKind kind) const;
+
+    // creates a diagnostic sensor for each healthCounter, published every HEALTH_SENSORS_INTERVAL_MS
+    void set_health_sensors(bool enabled);
+    // sets the health counters back to 0, it can be called from a lambda of an api service or of a button
+    void reset_health_counters();
+    uint32_t get_health_counter(healthCounter counter) const;
 
     climate::ClimateTraits traits() override;
 
@@ -91,6 +154,10 @@ protected:
     // HeatPump object using the underlying Arduino library.
     // same as PolingComponent
     uint32_t update_interval_;
+    uint32_t min_update_interval_ = 0;
+    uint32_t max_update_interval_ = 0;
+    uint32_t pollIntervalMs = 0;            // interval programmed by the last programUpdateInterval()
+    uint64_t lastActivityMs = 0;            // last user command, IR change or compressor frequency change
 
     climate::ClimateTraits traits_;
     //Accessor method for the HardwareSerial pointer
@@ -103,37 +170,42 @@ protected:
     void check_logger_conflict_();
 
     bool processInput(void);
-    void parse(uint8_t inputData);
-    void checkHeader(uint8_t inputData);
     void initBytePointer();
-    void processDataPacket();
+    void processDataPacket(const cn105Frame& frame);
     void getDataFromResponsePacket();
     void programUpdateInterval();
-    void updateSuccess();
-    void processCommand();
-    bool checkSum();
-    uint8_t checkSum(uint8_t bytes[], int len);
-
-    void setModeSetting(const char* setting);
-    void setPowerSetting(const char* setting);
+    uint32_t nextPollInterval();
+    void pollActivity(const char* reason);
+    void updateSuccess(const txTransaction* request);
+    void processCommand(const txTransaction* request);
+    void transactionFailed(const txTransaction& transaction);
+    void programConnectRetry(healthCounter cause);
+    void transportLost(const char* reason);
+    void beginSnapshot();
+    void commitSnapshot();
+    void settingsReceived(heatpumpSettings& settings);
+    void statusReceived(heatpumpStatus& status);
+    uint32_t get_snapshot_age_ms();
+
+    void setModeSetting(hpMode setting);
+    void setPowerSetting(hpPower setting);
+    void setVaneSetting(hpVane setting);
     void setVaneSetting(const char* setting);
-    void setWideVaneSetting(const char* setting);
-    void setFanSpeed(const char* setting);
+    void wantedSettingsChanged();
+    void setWideVaneSetting(hpWideVane setting);
+    void setFanSpeed(hpFan setting);
 private:
 
-    const char* lookupByteMapValue(const char* valuesMap[], const uint8_t byteMap[], int len, uint8_t byteValue);
-    int lookupByteMapValue(const int valuesMap[], const uint8_t byteMap[], int len, uint8_t byteValue);
-    int lookupByteMapIndex(const char* valuesMap[], int len, const char* lookupValue);
-    int lookupByteMapIndex(const int valuesMap[], int len, int lookupValue);
-    void writePacket(uint8_t* packet, int length, bool checkIsActive = true);
-    void prepareInfoPacket(uint8_t* packet, int length);
-    void prepareSetPacket(uint8_t* packet, int length);
+    int lookupByteMapIndex(const protocolMap& map, const char* lookupValue);
+    int lookupByteMapIndex(const protocolMap& map, int lookupValue);
+    bool writePacket(const uint8_t* packet, int length, txPriority priority, bool checkIsActive = true);
+    void processTxQueue();
 
     void publishStateToHA(heatpumpSettings settings);
 
     //void settingsChanged(heatpumpSettings settings, const char* source);
 
-    void wantedSettingsUpdateSuccess(heatpumpSettings settings);
+    void wantedSettingsUpdateSuccess(const heatpumpSettings& settings, uint8_t fields);
     void extTempUpdateSuccess();
     void heatpumpUpdate(heatpumpSettings settings);
 
@@ -145,24 +217,33 @@ private:
     void checkVaneSettings(heatpumpSettings& settings);
 
     void statusChanged();
+    void publishClimateState();
+    void publishCompressorFrequency(uint8_t frequency);
+    void publishLatencySensors();
+    void publishHealthSensors();
+    void recordReplyLatency(const txTransaction& request);
     void updateAction();
     void setActionIfOperatingTo(climate::ClimateAction action);
-    void hpPacketDebug(uint8_t* packet, unsigned int length, const char* packetDirection);
+    void hpPacketDebug(const uint8_t* packet, unsigned int length, const char* packetDirection, logSubsystem subsystem);
 
-    void debugSettings(const char* settingName, heatpumpSettings settings);
-    void debugSettings(const char* settingName, wantedHeatpumpSettings settings);
-    void debugStatus(const char* statusName, heatpumpStatus status);
-    void debugSettingsAndStatus(const char* settingName, heatpumpSettings settings, heatpumpStatus status);
-    void createPacket(uint8_t* packet, heatpumpSettings settings);
+    void debugSettings(const char* settingName, const heatpumpSettings& settings);
+    void debugSettings(const char* settingName, const wantedHeatpumpSettings& settings);
+    void debugStatus(const char* statusName, const heatpumpStatus& status);
+    void debugSettingsAndStatus(const char* settingName, const heatpumpSettings& settings, const heatpumpStatus& status);
+    void createPacket(uint8_t* packet, const heatpumpSettings& settings, uint8_t fields);
     void createInfoPacket(uint8_t* packet, uint8_t packetType);
     heatpumpSettings currentSettings{};
     wantedHeatpumpSettings wantedSettings{};
 
 
-    unsigned long lastResponseMs;
+    uint64_t lastResponseMs = 0;
 
 
     HardwareSerial* hw_serial_;
+    uartTransport uart;
+    cn105Transport* transport;  // &uart unless set_transport() has been called
+    systemClock espClock;
+    cn105Clock* clock;          // &espClock unless set_clock() has been called
     int baud_ = 0;
     int tx_pin_ = -1;
     int rx_pin_ = -1;
@@ -174,14 +255,45 @@ private:
     bool isHeatpumpConnected_ = false;
 
     //HardwareSerial* _HardSerial{ nullptr };
-    unsigned long lastSend;
-    uint8_t storedInputData[MAX_DATA_BYTES]; // multi-byte data
-    uint8_t* data;
+    uint64_t lastSend;
+    uint32_t coalescingWindowMs = DEFAULT_COMMAND_COALESCING_WINDOW_MS;
+    uint64_t lastControlMs = 0;             // last time the user changed the wanted settings
+    uint32_t pendingCommands = 0;           // control() calls carried by the pending set packet
+    frameReader rxFrameReader;
+    txFrameQueue txQueue;
+    rttTable roundTripTimes;
+    uint32_t health[HEALTH_COUNTER_COUNT] = {};
+    uint32_t lastDeferredSequence = 0;      // a frame waiting for room in the UART is a single deferred write
+    bool connectRetryPending = false;       // CONNECT_RETRY_NAME is programmed
+    packetTrace trace;          // every frame written to or read from the UART
+    const uint8_t* data;        // data bytes of the frame being processed
 
     // initialise to all off, then it will update shortly after connect;
-    heatpumpStatus currentStatus{ 0, false, {TIMER_MODE_MAP[0], 0, 0, 0, 0}, 0 };
+    heatpumpStatus currentStatus{};
     heatpumpFunctions functions;
 
+    // last values published to HA, see statePublishing.cpp
+    publishFilter currentTemperatureFilter;
+    publishFilter compressorFrequencyFilter;
+    bool climateStatePublished = false;
+    climate::ClimateMode publishedMode;
+    climate::ClimateAction publishedAction;
+    optional<climate::ClimateFanMode> publishedFanMode;
+    climate::ClimateSwingMode publishedSwingMode;
+    float publishedTargetTemperature = NAN;
+    bool publishHeld = false;               // publishes are held while a snapshot is applied
+    bool publishPending = false;
+
+    latencyHistogram latencies[LATENCY_KIND_COUNT];
+    uint64_t commandStartedMs = 0;          // first control() call not yet carried by a published state
+    bool commandApplied = false;            // the heatpump acknowledged it: the next publish carries it
+
+    heatpumpSnapshot snapshot;
+    bool snapshotInProgress = false;
+    uint64_t lastSnapshotMs = 0;            // commit time of the last snapshot
+
+    uint8_t logLevels[LOG_SUBSYSTEM_COUNT] = { DEFAULT_SUBSYSTEM_LOG_LEVEL, DEFAULT_SUBSYSTEM_LOG_LEVEL, DEFAULT_SUBSYSTEM_LOG_LEVEL };
+
     bool tempMode = false;
     bool wideVaneAdj;
     bool autoUpdate;
@@ -192,12 +304,23 @@ private:
     // counter for status request for checking heatpump is still connected
     // is the counter > MAX_NON_RESPONSE_REQ then we conclude uart is not connected anymore
     int nonResponseCounter = 0;
+    int failedTransactions = 0;         // consecutive requests left without reply after their retries
+
+    // poll cycle: the info requests are sent one after the other, the next one
+    // as soon as the reply to the previous one has been processed
+    int pollRequests[INFOMODE_LEN];
+    int pollRequestsCount = 0;
+    int pollRequestIndex = 0;
+    int awaitedInfoType = -1;           // data type (0x02, 0x03...) of the pending poll request, -1 if none
+    uint32_t pollPeriodsMs[INFOMODE_LEN];
+    uint64_t lastPolledMs[INFOMODE_LEN];
+    bool polledOnce[INFOMODE_LEN];
+    bool remoteTemperatureActive = false;   // room temperature comes from set_remote_temperature(), no need to poll it
+    bool isPollDue(int packetType);
 
     bool isReading = false;
     bool isWriting = false;
 
-    bool foundStart = false;
-    int bytesRead = 0;
     int dataLength = 0;
     uint8_t command = 0;
 };
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * Monotonic 64 bits time base of CN105Climate
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * All the timing of the component (poll periods, reply timeouts, connection watchdog,
+ * command coalescing...) reads this clock, so the differences between two readings never
+ * wrap: the 32 bits millis() wraps after 49.7 days and micros() after 71.6 minutes.
+ *
+ * The implementations are:
+ *  - systemClock (systemClock.h): the clock of the ESP, the default
+ *  - virtualClock (below): moved by hand, a test can fast-forward days of polling
+*/
+class cn105Clock {
+public:
+    virtual ~cn105Clock() {}
+
+    virtual uint64_t nowMs() = 0;
+    virtual uint64_t nowUs() = 0;
+};
+
+/**
+ * widens a free running 32 bits counter to 64 bits
+ * it must be sampled at least once per wrap period of the counter
+*/
+struct wrapExtender {
+    uint32_t last = 0;
+    uint64_t high = 0;
+
+    uint64_t extend(uint32_t counter) {
+        if (counter < this->last) {
+            this->high += (uint64_t)1 << 32;
+        }
+        this->last = counter;
+        return this->high | counter;
+    }
+};
+
+class virtualClock : public cn105Clock {
+public:
+    explicit virtualClock(uint64_t startUs = 0) : us(startUs) {}
+
+    uint64_t nowMs() override {
+        return this->us / 1000;
+    }
+    uint64_t nowUs() override {
+        return this->us;
+    }
+
+    void advanceUs(uint64_t delta) {
+        this->us += delta;
+    }
+    void advanceMs(uint64_t delta) {
+        this->us += delta * 1000;
+    }
+
+private:
+    uint64_t us;
+};
@@ -0,0 +1,433 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "protocolTables.h"
+#include "heatpumpFunctions.h"
+
+/**
+ * Encoding and decoding of the CN105 packets
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host,
+ * CN105Climate only adds the logging, the scheduling and the UART around it.
+ *
+ * encoders write a whole frame, checksum included, in out and return its length,
+ * or 0 when capacity is too small.
+ * decoders read the data bytes of a 0x62 reply (data[0] is the info type, see cn105Frame::data())
+ * and only update the fields carried by that reply.
+*/
+
+static const int PACKET_LEN = 22;               // set and info packets
+static const int CONNECT_LEN = 8;
+static const uint8_t CONNECT[CONNECT_LEN] = { 0xfc, 0x5a, 0x01, 0x30, 0x02, 0xca, 0x01, 0xa8 };
+static const int HEADER_LEN = 8;
+static const uint8_t HEADER[HEADER_LEN] = { 0xfc, 0x41, 0x01, 0x30, 0x10, 0x01, 0x00, 0x00 };
+static const int INFOHEADER_LEN = 5;
+static const uint8_t INFOHEADER[INFOHEADER_LEN] = { 0xfc, 0x42, 0x01, 0x30, 0x10 };
+
+static const uint8_t SET_TYPE_SETTINGS = 0x01;
+static const uint8_t SET_TYPE_REMOTE_TEMP = 0x07;
+static const uint8_t FUNCTIONS_SET_PART1 = 0x1F;
+static const uint8_t FUNCTIONS_GET_PART1 = 0x20;
+static const uint8_t FUNCTIONS_SET_PART2 = 0x21;
+static const uint8_t FUNCTIONS_GET_PART2 = 0x22;
+static const int FUNCTIONS_DATA_LEN = 0x10;     // info type + 15 bytes of functions
+
+static const int TIMER_INCREMENT_MINUTES = 10;
+
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "heatpumpSettings and heatpumpStatus comparison masks expect a little endian target"
+#endif
+
+/**
+ * settings and status are stored as small enums (indexes in the protocolTables.h maps),
+ * 8 bytes each, so that comparing or copying them is a single 64 bits operation.
+ * Strings are only used for logging and at the Home Assistant boundary.
+*/
+/**
+ * fields of heatpumpSettings which can be set, used as a bit mask
+ * the 5 first ones have the same value as the SET_FLAG1_* flags of the set packet
+*/
+static const uint8_t SETTINGS_FIELD_POWER = SET_FLAG1_POWER;
+static const uint8_t SETTINGS_FIELD_MODE = SET_FLAG1_MODE;
+static const uint8_t SETTINGS_FIELD_TEMP = SET_FLAG1_TEMP;
+static const uint8_t SETTINGS_FIELD_FAN = SET_FLAG1_FAN;
+static const uint8_t SETTINGS_FIELD_VANE = SET_FLAG1_VANE;
+static const uint8_t SETTINGS_FIELD_WIDEVANE = 0x20;
+static const uint8_t SETTINGS_FIELD_ALL = 0x3F;
+
+struct heatpumpSettings {
+    hpPower power = HP_POWER_OFF;
+    hpMode mode = HP_MODE_HEAT;
+    hpFan fan = HP_FAN_AUTO;
+    hpVane vane = HP_VANE_AUTO; //vertical vane, up/down
+    uint8_t temperature2x = 0;  // target temperature in half degrees
+    hpWideVane wideVane = HP_WIDEVANE_LEFT_LEFT; //horizontal vane, left/right
+    bool iSee = false;   //iSee sensor, at the moment can only detect it, not set it
+    bool connected = false;
+
+    // power, mode, fan, vane, temperature and wideVane are compared (the 6 first bytes)
+    static const uint64_t COMPARE_MASK = 0x0000FFFFFFFFFFFFULL;
+
+    uint64_t packed() const {
+        uint64_t word;
+        memcpy(&word, this, sizeof(word));
+        return word;
+    }
+
+    float getTemperature() const {
+        return this->temperature2x / 2.0f;
+    }
+
+    void setTemperature(float temperature) {
+        this->temperature2x = (uint8_t)lroundf(temperature * 2);
+    }
+
+    // copies the fields of source selected by the SETTINGS_FIELD_* mask fields
+    void merge(const heatpumpSettings& source, uint8_t fields) {
+        if (fields & SETTINGS_FIELD_POWER) this->power = source.power;
+        if (fields & SETTINGS_FIELD_MODE) this->mode = source.mode;
+        if (fields & SETTINGS_FIELD_TEMP) this->temperature2x = source.temperature2x;
+        if (fields & SETTINGS_FIELD_FAN) this->fan = source.fan;
+        if (fields & SETTINGS_FIELD_VANE) this->vane = source.vane;
+        if (fields & SETTINGS_FIELD_WIDEVANE) this->wideVane = source.wideVane;
+    }
+
+    // SETTINGS_FIELD_* mask of the fields whose value is not the same in other
+    uint8_t differingFields(const heatpumpSettings& other) const {
+        uint8_t fields = 0;
+        if (this->power != other.power) fields |= SETTINGS_FIELD_POWER;
+        if (this->mode != other.mode) fields |= SETTINGS_FIELD_MODE;
+        if (this->temperature2x != other.temperature2x) fields |= SETTINGS_FIELD_TEMP;
+        if (this->fan != other.fan) fields |= SETTINGS_FIELD_FAN;
+        if (this->vane != other.vane) fields |= SETTINGS_FIELD_VANE;
+        if (this->wideVane != other.wideVane) fields |= SETTINGS_FIELD_WIDEVANE;
+        return fields;
+    }
+
+    bool operator==(const heatpumpSettings& other) const {
+        return ((this->packed() ^ other.packed()) & COMPARE_MASK) == 0;
+    }
+
+    bool operator!=(const heatpumpSettings& other) const {
+        return !(this->operator==(other));
+    }
+
+};
+
+static_assert(sizeof(heatpumpSettings) == sizeof(uint64_t), "heatpumpSettings must fit in 64 bits");
+
+struct heatpumpTimers {
+    hpTimerMode mode = HP_TIMER_NONE;
+    uint8_t onMinutesSet = 0;           // in TIMER_INCREMENT_MINUTES
+    uint8_t onMinutesRemaining = 0;
+    uint8_t offMinutesSet = 0;
+    uint8_t offMinutesRemaining = 0;
+};
+
+struct heatpumpStatus {
+    uint8_t roomTemperatureCode = 0x80;     // high resolution encoding, see encodeHighResTemperature()
+    uint8_t compressorFrequency = 0;
+    bool operating = false; // if true, the heatpump is operating to reach the desired temperature
+    heatpumpTimers timers;
+
+    uint64_t packed() const {
+        uint64_t word;
+        memcpy(&word, this, sizeof(word));
+        return word;
+    }
+
+    float getRoomTemperature() const {
+        return decodeHighResTemperature(this->roomTemperatureCode);
+    }
+
+    void setRoomTemperature(float temperature) {
+        this->roomTemperatureCode = encodeHighResTemperature(temperature);
+    }
+
+    bool operator==(const heatpumpStatus& other) const {
+        return this->packed() == other.packed();
+    }
+
+    bool operator!=(const heatpumpStatus& other) const {
+        return !(*this == other);
+    }
+};
+
+static_assert(sizeof(heatpumpStatus) == sizeof(uint64_t), "heatpumpStatus must fit in 64 bits");
+
+
+// ---------------------------------------------------------------------------------------------
+// encoders
+
+inline uint8_t cn105Checksum(const uint8_t* bytes, size_t length) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return (0xfc - sum) & 0xff;
+}
+
+// copies header at the start of a zeroed PACKET_LEN frame
+inline size_t beginPacket(uint8_t* out, size_t capacity, const uint8_t* header, size_t headerLength) {
+    if (capacity < (size_t)PACKET_LEN) {
+        return 0;
+    }
+    memset(out, 0, PACKET_LEN);
+    memcpy(out, header, headerLength);
+    return PACKET_LEN;
+}
+
+inline size_t endPacket(uint8_t* out) {
+    out[PACKET_LEN - 1] = cn105Checksum(out, PACKET_LEN - 1);
+    return PACKET_LEN;
+}
+
+inline size_t encodeConnectPacket(uint8_t* out, size_t capacity) {
+    if (capacity < (size_t)CONNECT_LEN) {
+        return 0;
+    }
+    memcpy(out, CONNECT, CONNECT_LEN);
+    return CONNECT_LEN;
+}
+
+// 0x42 request, infoType is one of the INFOMODE bytes or FUNCTIONS_GET_PART1/2
+inline size_t encodeInfoRequest(uint8_t* out, size_t capacity, uint8_t infoType) {
+    if (beginPacket(out, capacity, INFOHEADER, INFOHEADER_LEN) == 0) {
+        return 0;
+    }
+    out[5] = infoType;
+    return endPacket(out);
+}
+
+/**
+ * 0x41 0x01 set packet: only the SETTINGS_FIELD_* of fields are written, with their
+ * SET_FLAG1_* / SET_FLAG2_* flag, the heatpump leaves the other ones untouched
+ * tempMode selects the high resolution setpoint, the legacy one only has whole degrees (16 to 31)
+*/
+inline size_t encodeSettingsPacket(uint8_t* out, size_t capacity, const heatpumpSettings& settings, uint8_t fields, bool tempMode, bool wideVaneAdj) {
+    if (beginPacket(out, capacity, HEADER, HEADER_LEN) == 0) {
+        return 0;
+    }
+
+    if (fields & SETTINGS_FIELD_POWER) {
+        out[SET_POWER_OFFSET] = POWER_MAP.byteAt(settings.power);
+        out[SET_FLAGS1_OFFSET] |= SET_FLAG1_POWER;
+    }
+    if (fields & SETTINGS_FIELD_MODE) {
+        out[SET_MODE_OFFSET] = MODE_MAP.byteAt(settings.mode);
+        out[SET_FLAGS1_OFFSET] |= SET_FLAG1_MODE;
+    }
+    if (fields & SETTINGS_FIELD_TEMP) {
+        if (tempMode) {
+            out[SET_TEMP_HIGHRES_OFFSET] = encodeHighResTemperature(settings.getTemperature());
+        } else {
+            // an unknown value is encoded as the first entry of the table
+            int index = TEMP_MAP.indexOfValue((int)settings.getTemperature());
+            out[SET_TEMP_OFFSET] = TEMP_MAP.byteAt(index > -1 ? index : 0);
+        }
+        out[SET_FLAGS1_OFFSET] |= SET_FLAG1_TEMP;
+    }
+    if (fields & SETTINGS_FIELD_FAN) {
+        out[SET_FAN_OFFSET] = FAN_MAP.byteAt(settings.fan);
+        out[SET_FLAGS1_OFFSET] |= SET_FLAG1_FAN;
+    }
+    if (fields & SETTINGS_FIELD_VANE) {
+        out[SET_VANE_OFFSET] = VANE_MAP.byteAt(settings.vane);
+        out[SET_FLAGS1_OFFSET] |= SET_FLAG1_VANE;
+    }
+    if (fields & SETTINGS_FIELD_WIDEVANE) {
+        out[SET_WIDEVANE_OFFSET] = WIDEVANE_MAP.byteAt(settings.wideVane) | (wideVaneAdj ? WIDEVANE_ADJ_FLAG : 0x00);
+        out[SET_FLAGS2_OFFSET] |= SET_FLAG2_WIDEVANE;
+    }
+    return endPacket(out);
+}
+
+/**
+ * reads back a set packet built by encodeSettingsPacket(): returns the SETTINGS_FIELD_* it
+ * carries, their values are written in settings (a byte not in its table leaves its field as is)
+*/
+inline uint8_t decodeSettingsPacket(const uint8_t* packet, heatpumpSettings& settings) {
+    uint8_t fields = packet[SET_FLAGS1_OFFSET] & (SETTINGS_FIELD_POWER | SETTINGS_FIELD_MODE | SETTINGS_FIELD_TEMP | SETTINGS_FIELD_FAN | SETTINGS_FIELD_VANE);
+    if (packet[SET_FLAGS2_OFFSET] & SET_FLAG2_WIDEVANE) {
+        fields |= SETTINGS_FIELD_WIDEVANE;
+    }
+    int index;
+    if ((fields & SETTINGS_FIELD_POWER) && (index = POWER_MAP.indexOfByte(packet[SET_POWER_OFFSET])) != -1) {
+        settings.power = (hpPower)index;
+    }
+    if ((fields & SETTINGS_FIELD_MODE) && (index = MODE_MAP.indexOfByte(packet[SET_MODE_OFFSET])) != -1) {
+        settings.mode = (hpMode)index;
+    }
+    if (fields & SETTINGS_FIELD_TEMP) {
+        if (packet[SET_TEMP_HIGHRES_OFFSET] != 0) {
+            settings.setTemperature(decodeHighResTemperature(packet[SET_TEMP_HIGHRES_OFFSET]));
+        } else if ((index = TEMP_MAP.indexOfByte(packet[SET_TEMP_OFFSET])) != -1) {
+            settings.setTemperature(TEMP_MAP.valueAt(index));
+        }
+    }
+    if ((fields & SETTINGS_FIELD_FAN) && (index = FAN_MAP.indexOfByte(packet[SET_FAN_OFFSET])) != -1) {
+        settings.fan = (hpFan)index;
+    }
+    if ((fields & SETTINGS_FIELD_VANE) && (index = VANE_MAP.indexOfByte(packet[SET_VANE_OFFSET])) != -1) {
+        settings.vane = (hpVane)index;
+    }
+    if ((fields & SETTINGS_FIELD_WIDEVANE) && (index = WIDEVANE_MAP.indexOfByte(packet[SET_WIDEVANE_OFFSET] & WIDEVANE_MASK)) != -1) {
+        settings.wideVane = (hpWideVane)index;
+    }
+    return fields;
+}
+
+/**
+ * 0x41 0x07 packet: temperature is rounded to the half degree,
+ * 0 or less gives the room temperature measurement back to the unit's own sensor
+*/
+inline size_t encodeRemoteTemperaturePacket(uint8_t* out, size_t capacity, float temperature) {
+    if (beginPacket(out, capacity, HEADER, HEADER_LEN) == 0) {
+        return 0;
+    }
+    out[SET_TYPE_OFFSET] = SET_TYPE_REMOTE_TEMP;
+    if (temperature > 0) {
+        float rounded = roundf(temperature * 2) / 2;
+        out[REMOTETEMP_FLAG_OFFSET] = 0x01;
+        out[REMOTETEMP_OFFSET] = (uint8_t)(int)(3 + ((rounded - 10) * 2));
+        out[REMOTETEMP_HIGHRES_OFFSET] = encodeHighResTemperature(rounded);
+    } else {
+        out[REMOTETEMP_FLAG_OFFSET] = 0x00;
+        out[REMOTETEMP_HIGHRES_OFFSET] = 0x80; //MHK1 send 80, even though it could be 00, since ControlByte is 00
+    }
+    return endPacket(out);
+}
+
+/**
+ * 0x41 0x1F / 0x21 packet carrying one half of the functions, part is FUNCTIONS_SET_PART1 or 2
+ * returns 0 when functions have not been read completely or hold an unset code:
+ * writing them would reset the missing functions of the unit
+*/
+inline size_t encodeFunctionsPacket(uint8_t* out, size_t capacity, const heatpumpFunctions& functions, uint8_t part) {
+    if (!functions.isValid() || beginPacket(out, capacity, HEADER, HEADER_LEN) == 0) {
+        return 0;
+    }
+    out[SET_TYPE_OFFSET] = part;
+    if (part == FUNCTIONS_SET_PART1) {
+        functions.getData1(&out[6]);
+    } else {
+        functions.getData2(&out[6]);
+    }
+
+    // sanity check, we expect data byte 15 (index 20) to be 0 and all the other data bytes to be set
+    if (out[20] != 0) {
+        return 0;
+    }
+    for (int i = 6; i < 20; ++i) {
+        if (out[i] == 0) {
+            return 0;
+        }
+    }
+    return endPacket(out);
+}
+
+
+// ---------------------------------------------------------------------------------------------
+// decoders
+
+enum codecResult : uint8_t {
+    CODEC_OK,
+    CODEC_UNKNOWN_VALUE,        // decoded, but a byte is not in its table: its first entry has been used
+    CODEC_TOO_SHORT             // nothing decoded
+};
+
+// index of b in map, 0 when it is unknown
+inline int decodeIndex(const protocolMap& map, uint8_t b, codecResult& result) {
+    int index = map.indexOfByte(b);
+    if (index == -1) {
+        result = CODEC_UNKNOWN_VALUE;
+        return 0;
+    }
+    return index;
+}
+
+struct settingsReply {
+    heatpumpSettings settings;
+    bool highResTemperature;    // the unit uses tempMode
+    bool wideVaneAdj;
+};
+
+// 0x02
+inline codecResult decodeSettings(const uint8_t* data, size_t length, settingsReply& reply) {
+    if (length <= SETTINGS_TEMP_HIGHRES_OFFSET) {
+        return CODEC_TOO_SHORT;
+    }
+    codecResult result = CODEC_OK;
+    heatpumpSettings& settings = reply.settings;
+
+    settings.connected = true;
+    settings.power = (hpPower)decodeIndex(POWER_MAP, data[SETTINGS_POWER_OFFSET], result);
+    settings.iSee = data[SETTINGS_MODE_OFFSET] > ISEE_FLAG;
+    settings.mode = (hpMode)decodeIndex(MODE_MAP, settings.iSee ? (data[SETTINGS_MODE_OFFSET] - ISEE_FLAG) : data[SETTINGS_MODE_OFFSET], result);
+
+    reply.highResTemperature = data[SETTINGS_TEMP_HIGHRES_OFFSET] != 0x00;
+    if (reply.highResTemperature) {
+        settings.setTemperature(decodeHighResTemperature(data[SETTINGS_TEMP_HIGHRES_OFFSET]));
+    } else {
+        settings.setTemperature(TEMP_MAP.valueAt(decodeIndex(TEMP_MAP, data[SETTINGS_TEMP_OFFSET], result)));
+    }
+
+    settings.fan = (hpFan)decodeIndex(FAN_MAP, data[SETTINGS_FAN_OFFSET], result);
+    settings.vane = (hpVane)decodeIndex(VANE_MAP, data[SETTINGS_VANE_OFFSET], result);
+    settings.wideVane = (hpWideVane)decodeIndex(WIDEVANE_MAP, data[SETTINGS_WIDEVANE_OFFSET] & WIDEVANE_MASK, result);
+    reply.wideVaneAdj = (data[SETTINGS_WIDEVANE_OFFSET] & WIDEVANE_ADJ_MASK) == WIDEVANE_ADJ_FLAG;
+    return result;
+}
+
+// 0x03
+inline codecResult decodeRoomTemperature(const uint8_t* data, size_t length, heatpumpStatus& status) {
+    if (length <= ROOMTEMP_HIGHRES_OFFSET) {
+        return CODEC_TOO_SHORT;
+    }
+    codecResult result = CODEC_OK;
+    if (data[ROOMTEMP_HIGHRES_OFFSET] != 0x00) {
+        status.roomTemperatureCode = data[ROOMTEMP_HIGHRES_OFFSET];
+    } else {
+        status.setRoomTemperature(ROOM_TEMP_MAP.valueAt(decodeIndex(ROOM_TEMP_MAP, data[ROOMTEMP_OFFSET], result)));
+    }
+    return result;
+}
+
+// 0x05
+inline codecResult decodeTimers(const uint8_t* data, size_t length, heatpumpTimers& timers) {
+    if (length <= TIMERS_OFF_REMAINING_OFFSET) {
+        return CODEC_TOO_SHORT;
+    }
+    codecResult result = CODEC_OK;
+    timers.mode = (hpTimerMode)decodeIndex(TIMER_MODE_MAP, data[TIMERS_MODE_OFFSET], result);
+    timers.onMinutesSet = data[TIMERS_ON_SET_OFFSET];
+    timers.offMinutesSet = data[TIMERS_OFF_SET_OFFSET];
+    timers.onMinutesRemaining = data[TIMERS_ON_REMAINING_OFFSET];
+    timers.offMinutesRemaining = data[TIMERS_OFF_REMAINING_OFFSET];
+    return result;
+}
+
+// 0x06
+inline codecResult decodeStatus(const uint8_t* data, size_t length, heatpumpStatus& status) {
+    if (length <= STATUS_OPERATING_OFFSET) {
+        return CODEC_TOO_SHORT;
+    }
+    status.operating = data[STATUS_OPERATING_OFFSET];
+    status.compressorFrequency = data[STATUS_COMPRESSOR_OFFSET];
+    return CODEC_OK;
+}
+
+// 0x20 / 0x22, each one carries one half of the functions
+inline codecResult decodeFunctions(const uint8_t* data, size_t length, heatpumpFunctions& functions) {
+    if (length != (size_t)FUNCTIONS_DATA_LEN) {
+        return CODEC_TOO_SHORT;
+    }
+    if (data[0] == FUNCTIONS_GET_PART1) {
+        functions.setData1(&data[1]);
+    } else {
+        functions.setData2(&data[1]);
+    }
+    return CODEC_OK;
+}
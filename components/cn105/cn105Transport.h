@@ -0,0 +1,140 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Byte stream between CN105Climate and the heatpump
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * The implementations are:
+ *  - uartTransport (uartTransport.h): the Arduino HardwareSerial wired to the CN105 connector
+ *  - tcpTransport (tcpTransport.h): a serial-over-network bridge, from the ESP or from a host
+ *  - ptyTransport (ptyTransport.h): a Linux PTY or tty, e.g. the one served by tools/cn105_emulator
+ *  - loopbackTransport (below): in memory, the test plays the heatpump
+ *
+ * None of the methods may block: the component calls them from loop(). A link which takes time
+ * to open (a TCP connection) is still opening when begin() returns, availableForWrite() is 0
+ * until it is open.
+*/
+class cn105Transport {
+public:
+    virtual ~cn105Transport() {}
+
+    // opens the link, 8E1 at baud for a serial port; false if it could not be opened
+    virtual bool begin(int baud) = 0;
+    virtual void end() = 0;
+
+    // bytes which can be read without waiting
+    virtual int available() = 0;
+    virtual size_t read(uint8_t* buffer, size_t length) = 0;
+
+    // bytes which can be written without waiting, -1 if the link is lost or could not be opened
+    virtual int availableForWrite() = 0;
+    virtual size_t write(const uint8_t* bytes, size_t length) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+
+#ifndef LOOPBACK_TRANSPORT_SIZE
+#define LOOPBACK_TRANSPORT_SIZE 256     // bytes buffered in each direction
+#endif
+
+/**
+ * In memory transport: the component side is the cn105Transport interface, the heatpump side
+ * is peerWrite() / peerRead(). Bytes which do not fit are dropped, like on a real UART.
+*/
+class loopbackTransport : public cn105Transport {
+public:
+    bool begin(int /*baud*/) override {
+        toComponent.clear();
+        toPeer.clear();
+        opened = true;
+        return true;
+    }
+
+    void end() override {
+        opened = false;
+    }
+
+    int available() override {
+        return opened ? (int)toComponent.size() : 0;
+    }
+
+    size_t read(uint8_t* buffer, size_t length) override {
+        return opened ? toComponent.pop(buffer, length) : 0;
+    }
+
+    int availableForWrite() override {
+        return opened ? (int)toPeer.room() : 0;
+    }
+
+    size_t write(const uint8_t* bytes, size_t length) override {
+        return opened ? toPeer.push(bytes, length) : 0;
+    }
+
+    const char* name() const override {
+        return "loopback";
+    }
+
+    bool isOpened() const {
+        return opened;
+    }
+
+    // bytes sent by the heatpump to the component
+    size_t peerWrite(const uint8_t* bytes, size_t length) {
+        return opened ? toComponent.push(bytes, length) : 0;
+    }
+
+    // bytes written by the component
+    size_t peerRead(uint8_t* buffer, size_t length) {
+        return toPeer.pop(buffer, length);
+    }
+
+    int peerAvailable() const {
+        return (int)toPeer.size();
+    }
+
+private:
+    struct ring {
+        uint8_t bytes[LOOPBACK_TRANSPORT_SIZE];
+        size_t head = 0;
+        size_t used = 0;
+
+        void clear() {
+            head = 0;
+            used = 0;
+        }
+
+        size_t size() const {
+            return used;
+        }
+
+        size_t room() const {
+            return LOOPBACK_TRANSPORT_SIZE - used;
+        }
+
+        size_t push(const uint8_t* data, size_t length) {
+            size_t n = length < room() ? length : room();
+            for (size_t i = 0; i < n; i++) {
+                bytes[(head + used) % LOOPBACK_TRANSPORT_SIZE] = data[i];
+                used++;
+            }
+            return n;
+        }
+
+        size_t pop(uint8_t* data, size_t length) {
+            size_t n = length < used ? length : used;
+            for (size_t i = 0; i < n; i++) {
+                data[i] = bytes[head];
+                head = (head + 1) % LOOPBACK_TRANSPORT_SIZE;
+                used--;
+            }
+            return n;
+        }
+    };
+
+    ring toComponent;
+    ring toPeer;
+    bool opened = false;
+};
@@ -31,6 +31,17 @@ void CN105Climate::setup() {
 
     this->setupUART();
     this->sendFirstConnectionPacket();
+
+    if (this->latency_sensors[0][0] != nullptr) {
+        this->set_interval(LATENCY_SENSORS_INTERVAL_NAME, LATENCY_SENSORS_INTERVAL_MS, [this]() {
+            this->publishLatencySensors();
+            });
+    }
+    if (this->health_sensors[0] != nullptr) {
+        this->set_interval(HEALTH_SENSORS_INTERVAL_NAME, HEALTH_SENSORS_INTERVAL_MS, [this]() {
+            this->publishHealthSensors();
+            });
+    }
 }
 
 
@@ -60,6 +71,21 @@ void CN105Climate::loop() {
     if (!this->processInput()) {
         this->checkPendingWantedSettings();
     }
+    this->processTxQueue();
+}
+
+uint64_t CN105Climate::next_loop_deadline_ms() {
+    uint64_t now = this->clock->nowMs();
+    if (this->transport->available() > 0 || (this->txQueue.size() > 0 && this->txQueue.ready() && !this->connectRetryPending)) {
+        return now;     // the queued frames are held until the connection is tried again
+    }
+    uint64_t deadline = this->txQueue.nextExpiryMs();      // retransmissions are decided by loop()
+    if (!this->firstRun && this->wantedSettings.dirtyFields != 0) {
+        // the set packet waits for the end of the coalescing window
+        uint64_t windowEnd = this->lastControlMs + this->coalescingWindowMs;
+        deadline = windowEnd < deadline ? windowEnd : deadline;
+    }
+    return deadline > now ? deadline : now;
 }
 
 
@@ -70,12 +96,13 @@ void CN105Climate::loop() {
 void CN105Climate::programUpdateInterval() {
     if (autoUpdate) {
         ESP_LOGD(TAG, "Autoupdate is ON --> creating a loop for reccurent updates...");
-        ESP_LOGD(TAG, "Programming update interval : %d", this->get_update_interval());
+        this->pollIntervalMs = this->nextPollInterval();
+        ESP_LOGD(TAG, "Programming update interval : %" PRIu32, this->pollIntervalMs);
 
         this->cancel_timeout(SHEDULER_INTERVAL_SYNC_NAME);     // in case a loop is already programmed
 
 
-        this->set_timeout(SHEDULER_INTERVAL_SYNC_NAME, this->get_update_interval(), [this]() {
+        this->set_timeout(SHEDULER_INTERVAL_SYNC_NAME, this->pollIntervalMs, [this]() {
 
             this->buildAndSendRequestsInfoPackets();
 
@@ -84,8 +111,71 @@ void CN105Climate::programUpdateInterval() {
     }
 }
 
+/**
+ * the poll interval adapts to the activity of the heatpump:
+ *  - min_update_interval during ADAPTIVE_FAST_PERIOD_MS after a user command, an IR remote change
+ *    or a change of the compressor frequency
+ *  - update_interval the rest of the time
+ *  - when the unit is off or nothing changed for ADAPTIVE_STABLE_AFTER_MS, doubled at each cycle
+ *    up to max_update_interval
+*/
+uint32_t CN105Climate::nextPollInterval() {
+    uint32_t minInterval = this->min_update_interval_ != 0 ? this->min_update_interval_ : this->update_interval_;
+    uint32_t maxInterval = this->max_update_interval_ != 0 ? this->max_update_interval_ : this->update_interval_;
+    uint64_t interval = this->update_interval_;      // 64 bits: doubling a large max_update_interval must not wrap
+
+    uint64_t quietMs = this->clock->nowMs() - this->lastActivityMs;
+
+    if (quietMs < ADAPTIVE_FAST_PERIOD_MS) {
+        interval = minInterval;
+    } else if ((this->currentSettings.power == HP_POWER_OFF) || (quietMs >= ADAPTIVE_STABLE_AFTER_MS)) {
+        interval = 2 * (this->pollIntervalMs > interval ? (uint64_t)this->pollIntervalMs : interval);
+    }
+
+    if (interval < minInterval) {
+        interval = minInterval;
+    }
+    if (interval > maxInterval) {
+        interval = maxInterval;
+    }
+    return (uint32_t)interval;
+}
+
+/**
+ * something changed: polls at min_update_interval, right away if a longer interval is programmed
+*/
+void CN105Climate::pollActivity(const char* reason) {
+    this->lastActivityMs = this->clock->nowMs();
+
+    if (this->autoUpdate && this->pollIntervalMs > this->nextPollInterval()) {
+        ESP_LOGD(TAG, "activity detected (%s): back to fast polling", reason);
+        this->programUpdateInterval();
+    }
+}
+
 uint32_t CN105Climate::get_update_interval() const { return this->update_interval_; }
 void CN105Climate::set_update_interval(uint32_t update_interval) {
     this->update_interval_ = update_interval;
+    this->pollIntervalMs = update_interval;
     this->autoUpdate = (update_interval != 0);
-}
\ No newline at end of file
+}
+
+void CN105Climate::set_min_update_interval(uint32_t min_update_interval) {
+    this->min_update_interval_ = min_update_interval;
+}
+
+void CN105Climate::set_max_update_interval(uint32_t max_update_interval) {
+    this->max_update_interval_ = max_update_interval;
+}
+
+uint32_t CN105Climate::get_poll_interval() const {
+    return this->pollIntervalMs;
+}
+
+void CN105Climate::set_command_coalescing_window(uint32_t window_ms) {
+    this->coalescingWindowMs = window_ms;
+}
+
+uint32_t CN105Climate::get_coalesced_commands() const {
+    return this->health[HEALTH_COALESCED_COMMANDS];
+}
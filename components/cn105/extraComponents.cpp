@@ -12,8 +12,7 @@ public:
         ESP_LOGD("EVT", "vane.control() -> Demande un chgt de réglage de la vane: %s", value.c_str());
 
         parent_->setVaneSetting(value.c_str()); // should be enough to trigger a sendWantedSettings
-        parent_->wantedSettings.hasChanged = true;
-        parent_->wantedSettings.hasBeenSent = false;
+        parent_->wantedSettingsChanged();
         // now updated thanks to new sendWantedSettings policy 
         // parent_->sendWantedSettings();
 
@@ -40,8 +39,57 @@ void CN105Climate::generateExtraComponents() {
     this->vane = new VaneOrientationSelect(this);
     this->vane->set_name("Vane");
 
-    std::vector<std::string> vaneOptions(std::begin(VANE_MAP), std::end(VANE_MAP));
+    std::vector<std::string> vaneOptions;
+    for (int i = 0; i < VANE_MAP.size(); i++) {
+        vaneOptions.push_back(VANE_MAP.nameAt(i));
+    }
     this->vane->traits.set_options(vaneOptions);
 
     App.register_select(this->vane);
-}
\ No newline at end of file
+}
+
+void CN105Climate::set_snapshot_age_sensor(bool enabled) {
+    if (!enabled || this->snapshot_age_sensor != nullptr) {
+        return;
+    }
+    this->snapshot_age_sensor = new sensor::Sensor();
+    this->snapshot_age_sensor->set_name("Snapshot Age");
+    this->snapshot_age_sensor->set_unit_of_measurement("s");
+    this->snapshot_age_sensor->set_accuracy_decimals(1);
+    this->snapshot_age_sensor->set_entity_category(ENTITY_CATEGORY_DIAGNOSTIC);
+    App.register_sensor(this->snapshot_age_sensor);
+}
+
+void CN105Climate::set_latency_sensors(bool enabled) {
+    if (!enabled || this->latency_sensors[0][0] != nullptr) {
+        return;
+    }
+    static const char* const STATISTICS[3] = { "p50", "p95", "max" };
+    for (int kind = 0; kind < LATENCY_KIND_COUNT; kind++) {
+        for (int statistic = 0; statistic < 3; statistic++) {
+            // the sensor keeps a pointer to its name
+            std::string* name = new std::string(std::string(LATENCY_NAMES[kind]) + " Latency " + STATISTICS[statistic]);
+            sensor::Sensor* latencySensor = new sensor::Sensor();
+            latencySensor->set_name(name->c_str());
+            latencySensor->set_unit_of_measurement("ms");
+            latencySensor->set_accuracy_decimals(0);
+            latencySensor->set_entity_category(ENTITY_CATEGORY_DIAGNOSTIC);
+            App.register_sensor(latencySensor);
+            this->latency_sensors[kind][statistic] = latencySensor;
+        }
+    }
+}
+
+void CN105Climate::set_health_sensors(bool enabled) {
+    if (!enabled || this->health_sensors[0] != nullptr) {
+        return;
+    }
+    for (int counter = 0; counter < HEALTH_COUNTER_COUNT; counter++) {
+        sensor::Sensor* healthSensor = new sensor::Sensor();
+        healthSensor->set_name(HEALTH_COUNTER_NAMES[counter]);
+        healthSensor->set_accuracy_decimals(0);
+        healthSensor->set_entity_category(ENTITY_CATEGORY_DIAGNOSTIC);
+        App.register_sensor(healthSensor);
+        this->health_sensors[counter] = healthSensor;
+    }
+}
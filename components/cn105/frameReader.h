@@ -0,0 +1,201 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Framing layer of the CN105 protocol
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * A frame is made of:
+ *  - a 5 bytes header: 0xFC, command, 0x01, 0x30, data length
+ *  - the data bytes
+ *  - 1 checksum byte: (0xFC - sum of all the previous bytes) & 0xFF
+*/
+
+#define MAX_DATA_BYTES     64       // max number of data bytes in incoming messages
+#define FRAME_START_BYTE   0xFC
+#define FRAME_HEADER_LEN   5
+#define FRAME_READER_BUFFER_SIZE 128    // must hold at least one frame of MAX_DATA_BYTES
+#define FRAME_MAX_LEN      (FRAME_HEADER_LEN + MAX_DATA_BYTES + 1)
+
+static const uint8_t FRAME_HEADER_BYTE2 = 0x01;
+static const uint8_t FRAME_HEADER_BYTE3 = 0x30;
+
+static_assert(FRAME_READER_BUFFER_SIZE >= FRAME_MAX_LEN, "frameReader buffer must hold a frame of MAX_DATA_BYTES");
+
+/**
+ * Framing failures, counted since the last reset
+*/
+struct frameReaderStats {
+    uint32_t frames;            // valid frames
+    uint32_t checksumErrors;
+    uint32_t headerErrors;      // bytes 2-3 are not 0x01 0x30
+    uint32_t lengthErrors;      // data length larger than MAX_DATA_BYTES
+    uint32_t skippedBytes;      // bytes found outside of a frame
+
+    uint32_t errors() const {
+        return checksumErrors + headerErrors + lengthErrors;
+    }
+};
+
+/**
+ * Zero-copy view on a complete frame stored in the frameReader buffer
+ * It is only valid until the next call to one of the frameReader methods
+*/
+struct cn105Frame {
+    const uint8_t* bytes;       // the whole frame, header and checksum included
+    uint8_t length;             // header + data + checksum
+
+    uint8_t command() const { return bytes[1]; }
+    uint8_t dataLength() const { return bytes[4]; }
+    const uint8_t* data() const { return bytes + FRAME_HEADER_LEN; }
+};
+
+/**
+ * Receives the UART bytes in bulk and cuts them into frames.
+ * The checksum is computed as the bytes are parsed, so a complete frame is never read twice.
+ *
+ * Only well formed frames are handed out. When a frame is rejected (bad header, data length
+ * too large or bad checksum) its start byte is skipped and the following bytes, which are
+ * still in the buffer, are scanned again for the next 0xFC: a corrupted byte costs one frame,
+ * not the frames that follow it.
+ *
+ * Bytes are appended at tail and consumed from head. When there is no room left at the end
+ * of the buffer, the pending bytes are moved back to the beginning instead of wrapping around:
+ * this way a frame is always contiguous and can be handed out without being copied.
+*/
+class frameReader {
+public:
+    frameReader() {
+        reset();
+        resetStats();
+    }
+
+    void reset() {
+        head = 0;
+        tail = 0;
+        scan = 0;
+        inFrame = false;
+        frameLength = 0;
+        runningSum = 0;
+    }
+
+    void resetStats() {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    const frameReaderStats& getStats() const {
+        return stats;
+    }
+
+    // pointer where the next received bytes must be written, writable() bytes are available there
+    uint8_t* writePointer() {
+        if (head == tail) {
+            // nothing pending: restart at the beginning of the buffer
+            head = tail = scan = 0;
+        } else if (tail == FRAME_READER_BUFFER_SIZE && head > 0) {
+            memmove(buffer, buffer + head, tail - head);
+            tail -= head;
+            scan -= head;
+            head = 0;
+        }
+        return buffer + tail;
+    }
+
+    size_t writable() const {
+        return FRAME_READER_BUFFER_SIZE - tail;
+    }
+
+    // records that n bytes have been written at writePointer()
+    void commit(size_t n) {
+        tail += n;
+    }
+
+    /**
+     * parses the pending bytes
+     * returns true when a complete and valid frame is available in frame
+    */
+    bool next(cn105Frame& frame) {
+        while (scan < tail) {
+            uint8_t b = buffer[scan];
+
+            if (!inFrame) {
+                if (b == FRAME_START_BYTE) {
+                    inFrame = true;
+                    frameLength = 0;            // unknown until the header is complete
+                    runningSum = b;
+                    head = scan;
+                } else {
+                    stats.skippedBytes++;       // unknown bytes
+                    head = scan + 1;
+                }
+                scan++;
+                continue;
+            }
+
+            size_t pos = scan - head;
+
+            if (pos == 2 && b != FRAME_HEADER_BYTE2) {
+                stats.headerErrors++;
+                resync();
+                continue;
+            }
+            if (pos == 3 && b != FRAME_HEADER_BYTE3) {
+                stats.headerErrors++;
+                resync();
+                continue;
+            }
+            if (pos == FRAME_HEADER_LEN - 1) {
+                if (b > MAX_DATA_BYTES) {
+                    stats.lengthErrors++;
+                    resync();
+                    continue;
+                }
+                frameLength = FRAME_HEADER_LEN + b + 1;
+            }
+
+            if (frameLength != 0 && pos == frameLength - 1) {
+                // this is the checksum byte: the frame is complete
+                if (((FRAME_START_BYTE - runningSum) & 0xFF) != b) {
+                    stats.checksumErrors++;
+                    resync();
+                    continue;
+                }
+
+                frame.bytes = buffer + head;
+                frame.length = (uint8_t)frameLength;
+                stats.frames++;
+
+                scan++;
+                head = scan;
+                inFrame = false;
+                return true;
+            }
+
+            runningSum += b;
+            scan++;
+        }
+
+        return false;
+    }
+
+private:
+    // drops the start byte of the rejected frame and scans again the bytes following it
+    void resync() {
+        stats.skippedBytes++;
+        head++;
+        scan = head;
+        inFrame = false;
+        frameLength = 0;
+    }
+
+    frameReaderStats stats;
+    uint8_t buffer[FRAME_READER_BUFFER_SIZE];
+    size_t head;            // first byte of the frame being parsed
+    size_t tail;            // end of the received bytes
+    size_t scan;            // next byte to parse
+    bool inFrame;
+    size_t frameLength;     // expected length of the current frame, 0 while the header is incomplete
+    uint8_t runningSum;
+};
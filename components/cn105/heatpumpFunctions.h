@@ -1,7 +1,15 @@
 #pragma once
-#include "Globals.h"
-
-
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Functions (installer settings) of the heatpump, read with the 0x20/0x22 requests
+ * and written with the 0x1F/0x21 set packets, 15 data bytes each
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * Each byte holds a function code (101 to 128) in its 6 high bits and its value (1 to 3)
+ * in its 2 low bits.
+*/
 
 #define MAX_FUNCTION_CODE_COUNT 30
 
@@ -11,35 +19,99 @@ struct heatpumpFunctionCodes {
 };
 
 
-
-
 class heatpumpFunctions {
 private:
     uint8_t raw[MAX_FUNCTION_CODE_COUNT];
     bool _isValid1;
     bool _isValid2;
 
-    int getCode(uint8_t b);
-    int getValue(uint8_t b);
+    static int getCode(uint8_t b) {
+        return ((b >> 2) & 0xff) + 100;
+    }
+
+    static int getValue(uint8_t b) {
+        return b & 3;
+    }
 
 public:
-    heatpumpFunctions();
+    heatpumpFunctions() {
+        clear();
+    }
 
-    bool isValid() const;
+    bool isValid() const {
+        return _isValid1 && _isValid2;
+    }
 
     // data must be 15 bytes
-    void setData1(uint8_t* data);
-    void setData2(uint8_t* data);
-    void getData1(uint8_t* data) const;
-    void getData2(uint8_t* data) const;
-
-    void clear();
-
-    int getValue(int code);
-    bool setValue(int code, int value);
-
-    heatpumpFunctionCodes getAllCodes();
-
-    bool operator==(const heatpumpFunctions& rhs);
-    bool operator!=(const heatpumpFunctions& rhs);
+    void setData1(const uint8_t* data) {
+        memcpy(raw, data, 15);
+        _isValid1 = true;
+    }
+
+    void setData2(const uint8_t* data) {
+        memcpy(raw + 15, data, 15);
+        _isValid2 = true;
+    }
+
+    void getData1(uint8_t* data) const {
+        memcpy(data, raw, 15);
+    }
+
+    void getData2(uint8_t* data) const {
+        memcpy(data, raw + 15, 15);
+    }
+
+    void clear() {
+        memset(raw, 0, sizeof(raw));
+        _isValid1 = false;
+        _isValid2 = false;
+    }
+
+    int getValue(int code) {
+        if (code > 128 || code < 101)
+            return 0;
+
+        for (int i = 0; i < MAX_FUNCTION_CODE_COUNT; ++i) {
+            if (getCode(raw[i]) == code)
+                return getValue(raw[i]);
+        }
+
+        return 0;
+    }
+
+    bool setValue(int code, int value) {
+        if (code > 128 || code < 101)
+            return false;
+
+        if (value < 1 || value > 3)
+            return false;
+
+        for (int i = 0; i < MAX_FUNCTION_CODE_COUNT; ++i) {
+            if (getCode(raw[i]) == code) {
+                raw[i] = ((code - 100) << 2) + value;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    heatpumpFunctionCodes getAllCodes() {
+        heatpumpFunctionCodes result;
+        for (int i = 0; i < MAX_FUNCTION_CODE_COUNT; ++i) {
+            int code = getCode(raw[i]);
+            result.code[i] = code;
+            result.valid[i] = (code >= 101 && code <= 128);
+        }
+
+        return result;
+    }
+
+    bool operator==(const heatpumpFunctions& rhs) const {
+        return this->isValid() == rhs.isValid() && memcmp(this->raw, rhs.raw, sizeof(this->raw)) == 0;
+    }
+
+    bool operator!=(const heatpumpFunctions& rhs) const {
+        return !(*this == rhs);
+    }
 };
@@ -1,17 +1,17 @@
 #include "cn105.h"
 
 /**
- * Seek the byte pointer to the beginning of the array
+ * Resets the frame reader
  * Initializes few variables
 */
 void CN105Climate::initBytePointer() {
-    this->foundStart = false;
-    this->bytesRead = 0;
+    this->rxFrameReader.reset();
     this->dataLength = -1;
     this->command = 0;
 }
 
 /**
+ * Drains the UART into the frame reader and processes every complete frame
  *
  * La taille totale d'une trame, se compose de plusieurs éléments :
  * Taille du Header : Le header a une longueur fixe de 5 octets (INFOHEADER_LEN).
@@ -19,283 +19,334 @@ void CN105Climate::initBytePointer() {
  * Checksum : Il y a 1 octet de checksum à la fin de la trame.
  *
  * La taille totale d'une trame est donc la somme de ces éléments : taille du header (5 octets) + longueur des données (variable) + checksum (1 octet).
- * Pour calculer la taille totale, on peut utiliser la formule :
- * Taille totale = 5 (header) + Longueur des données + 1 (checksum)
- * La taille totale dépend de la longueur spécifique des données pour chaque trame individuelle.
+ * Le découpage et le calcul du checksum sont faits par frameReader au fil de la réception.
  */
-void CN105Climate::parse(byte inputData) {
-
-    ESP_LOGV("Decoder", "--> %02X [nb: %d]", inputData, this->bytesRead);
-
-    if (!this->foundStart) {                // no packet yet
-        if (inputData == HEADER[0]) {
-            this->foundStart = true;
-            storedInputData[this->bytesRead++] = inputData;
-        } else {
-            // unknown bytes
-        }
-    } else {                                // we are getting a packet
-        storedInputData[this->bytesRead] = inputData;
+bool CN105Climate::processInput(void) {
+    bool processed = false;
+    int available;
+    uint32_t errorsBefore = this->rxFrameReader.getStats().errors();
+    uint32_t checksumErrorsBefore = this->rxFrameReader.getStats().checksumErrors;
 
-        checkHeader(inputData);
+    while ((available = this->transport->available()) > 0) {
+        processed = true;
 
-        if (this->dataLength != -1) {       // is header complete ?
+        uint8_t* buffer = this->rxFrameReader.writePointer();
+        size_t room = this->rxFrameReader.writable();
+        size_t len = this->transport->read(buffer, (size_t)available < room ? (size_t)available : room);
+        this->rxFrameReader.commit(len);
 
-            if ((this->bytesRead) == this->dataLength + 5) {
+        cn105Frame frame;
+        while (this->rxFrameReader.next(frame)) {
+            this->processDataPacket(frame);
+        }
 
-                this->processDataPacket();
-                this->initBytePointer();
-            } else {                                        // packet is still filling
-                this->bytesRead++;                          // more data to come
-            }
-        } else {
-            ESP_LOGV("Decoder", "data length toujours pas connu");
-            // header is not complete yet
-            this->bytesRead++;
+        if (len == 0) {
+            break;
         }
     }
 
+    if (this->rxFrameReader.getStats().errors() != errorsBefore) {
+        const frameReaderStats& stats = this->rxFrameReader.getStats();
+        this->health[HEALTH_CHECKSUM_ERRORS] += stats.checksumErrors - checksumErrorsBefore;
+        ESP_LOGW("Decoder", "frames rejected -> checksum: %" PRIu32 ", header: %" PRIu32 ", length: %" PRIu32 " (skipped bytes: %" PRIu32 ")",
+            stats.checksumErrors, stats.headerErrors, stats.lengthErrors, stats.skippedBytes);
+    }
+    return processed;
 }
 
+void CN105Climate::processDataPacket(const cn105Frame& frame) {
 
-bool CN105Climate::checkSum() {
-    // TODO: use the CN105Climate::checkSum(byte bytes[], int len) function
+    CN105_LOGV(LOG_SUBSYSTEM_DECODER, TAG, "processing data packet...");
 
-    uint8_t packetCheckSum = storedInputData[this->bytesRead];
-    uint8_t processedCS = 0;
+    this->trace.record((uint32_t)this->clock->nowUs(), false, frame.bytes, frame.length);
+    this->hpPacketDebug(frame.bytes, frame.length, "READ", LOG_SUBSYSTEM_DECODER);
 
-    ESP_LOGV("chkSum", "controling chkSum should be: %02X ", packetCheckSum);
-
-    for (int i = 0;i < this->dataLength + 5;i++) {
-        ESP_LOGV("chkSum", "adding %02X to %02X --> ", this->storedInputData[i], processedCS, processedCS + this->storedInputData[i]);
-        processedCS += this->storedInputData[i];
+    switch (frame.command()) {
+    case 0x61: this->health[HEALTH_RX_ACK]++; break;
+    case 0x62: this->health[HEALTH_RX_INFO]++; break;
+    case 0x7A: this->health[HEALTH_RX_CONNECT]++; break;
+    default: break;
     }
 
-    processedCS = (0xfc - processedCS) & 0xff;
-
-    if (packetCheckSum == processedCS) {
-        ESP_LOGD("chkSum", "OK-> %02X=%02X ", processedCS, packetCheckSum);
+    // the request this frame answers, if it is still in flight
+    txTransaction request;
+    bool answered = this->txQueue.replyReceived(frame.bytes, frame.length, request);
+    if (answered) {
+        this->failedTransactions = 0;
+        this->recordReplyLatency(request);
+        if (request.frame.retries == 0) {      // the reply to a retransmission could answer any of the copies
+            uint64_t nowUs = this->clock->nowUs();
+            uint32_t rttUs = nowUs > request.txDoneUs ? (uint32_t)(nowUs - request.txDoneUs) : 0;
+            this->roundTripTimes.sample(request.command(), request.type(), rttUs);
+            CN105_LOGV(LOG_SUBSYSTEM_DECODER, TAG, "round trip of (%02X %02X): %" PRIu32 " us, timeout %" PRIu32 " ms",
+                request.command(), request.type(), rttUs, this->roundTripTimes.of(request.command(), request.type()).timeoutMs());
+        }
     } else {
-        ESP_LOGW("chkSum", "KO-> %02X!=%02X ", processedCS, packetCheckSum);
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, TAG, "[%02X] frame answers no pending request", frame.command());
     }
 
-    return (packetCheckSum == processedCS);
-}
+    // the frame reader only hands out frames with a valid header and checksum
+    this->command = frame.command();
+    this->dataLength = frame.dataLength();
+    this->data = frame.data();
 
+    // checkPoint of a heatpump response
+    this->lastResponseMs = this->clock->nowMs();
 
-void CN105Climate::checkHeader(byte inputData) {
-    if (this->bytesRead == 4) {
-        if (storedInputData[2] == HEADER[2] && storedInputData[3] == HEADER[3]) {
-            ESP_LOGV("Header", "header matches HEADER");
-            ESP_LOGV("Header", "[%02X] (%02X) %02X %02X [%02X]<-- header", storedInputData[0], storedInputData[1], storedInputData[2], storedInputData[3], storedInputData[4]);
-            ESP_LOGD("Header", "command: (%02X) data length: [%02X]<-- header", storedInputData[1], storedInputData[4]);
-            this->command = storedInputData[1];
-        }
-        this->dataLength = storedInputData[4];
-    }
-}
+    // processing the specific command
+    processCommand(answered ? &request : nullptr);
 
-bool CN105Climate::processInput(void) {
-    bool processed = false;
-    while (this->get_hw_serial_()->available()) {
-        processed = true;
-        int inputData = this->get_hw_serial_()->read();
-        parse(inputData);
+    if (this->command == 0x62) {
+        // the poll cycle can go on with the next request
+        this->pollReplyReceived(this->data[0]);
     }
-    return processed;
 }
-
-void CN105Climate::processDataPacket() {
-
-    ESP_LOGV(TAG, "processing data packet...");
-
-    this->data = &this->storedInputData[5];
-
-    this->hpPacketDebug(this->storedInputData, this->bytesRead + 1, "READ");
-
-    if (this->checkSum()) {
-        // checkPoint of a heatpump response
-        this->lastResponseMs = CUSTOM_MILLIS;    //esphome::CUSTOM_MILLIS;        
-
-        // processing the specific command
-        processCommand();
+/**
+ * times the exchange from the first transmission of the request, retransmissions included:
+ * this is the delay the user sees
+*/
+void CN105Climate::recordReplyLatency(const txTransaction& request) {
+    latencyKind kind;
+    if (request.command() == 0x41) {
+        kind = LATENCY_SET_ACK;
+    } else if (request.command() != 0x42) {
+        return;
+    } else {
+        switch (request.type()) {
+        case 0x02: kind = LATENCY_SETTINGS_REPLY; break;
+        case 0x03: kind = LATENCY_ROOM_TEMP_REPLY; break;
+        case 0x06: kind = LATENCY_STATUS_REPLY; break;
+        case 0x20: kind = LATENCY_FUNCTIONS1_REPLY; break;
+        case 0x22: kind = LATENCY_FUNCTIONS2_REPLY; break;
+        default: return;
+        }
     }
+    this->latencies[kind].record((uint32_t)(this->clock->nowMs() - request.frame.firstSentMs));
 }
-void CN105Climate::getDataFromResponsePacket() {
-
-    heatpumpStatus receivedStatus{};
-    heatpumpSettings receivedSettings{};
 
+void CN105Climate::getDataFromResponsePacket() {
 
+    // a status reply only carries some of the fields, the other ones are kept
+    heatpumpStatus receivedStatus = this->snapshotInProgress ? this->snapshot.status : this->currentStatus;
+    codecResult result = CODEC_OK;
 
     bool statusDidChange = false;
 
     switch (this->data[0]) {
     case 0x02: {            /* setting information */
-        ESP_LOGD("Decoder", "[0x02 is settings]");
-        //this->last_received_packet_sensor->publish_state("0x62-> 0x02: Data -> Settings");        
-        receivedSettings.connected = true;      // we're here so we're connected (actually not used property)
-        receivedSettings.power = lookupByteMapValue(POWER_MAP, POWER, 2, data[3]);
-        receivedSettings.iSee = data[4] > 0x08 ? true : false;
-        receivedSettings.mode = lookupByteMapValue(MODE_MAP, MODE, 5, receivedSettings.iSee ? (data[4] - 0x08) : data[4]);
-
-        ESP_LOGD("Decoder", "[Power : %s]", receivedSettings.power);
-        ESP_LOGD("Decoder", "[iSee  : %d]", receivedSettings.iSee);
-        ESP_LOGD("Decoder", "[Mode  : %s]", receivedSettings.mode);
-
-        if (data[11] != 0x00) {
-            int temp = data[11];
-            temp -= 128;
-            receivedSettings.temperature = (float)temp / 2;
-            this->tempMode = true;
-            ESP_LOGD("Decoder", "tempMode is true");
-        } else {
-            receivedSettings.temperature = lookupByteMapValue(TEMP_MAP, TEMP, 16, data[5]);
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[0x02 is settings]");
+        settingsReply reply{};
+        result = decodeSettings(this->data, this->dataLength, reply);
+        if (result == CODEC_TOO_SHORT) {
+            break;
         }
+        heatpumpSettings& receivedSettings = reply.settings;
 
-        ESP_LOGD("Decoder", "[Consigne °C: %f]", receivedSettings.temperature);
-
-        receivedSettings.fan = lookupByteMapValue(FAN_MAP, FAN, 6, data[6]);
-        ESP_LOGD("Decoder", "[Fan: %s]", receivedSettings.fan);
-
-        receivedSettings.vane = lookupByteMapValue(VANE_MAP, VANE, 7, data[7]);
-        ESP_LOGD("Decoder", "[Vane: %s]", receivedSettings.vane);
-
-
-        receivedSettings.wideVane = lookupByteMapValue(WIDEVANE_MAP, WIDEVANE, 7, data[10] & 0x0F);
-
-
-
-        wideVaneAdj = (data[10] & 0xF0) == 0x80 ? true : false;
-
-        ESP_LOGD("Decoder", "[wideVane: %s (adj:%d)]", receivedSettings.wideVane, wideVaneAdj);
-
-        // moved to settingsChanged()
-        //currentSettings = receivedSettings;
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[Power : %s]", POWER_MAP.nameAt(receivedSettings.power));
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[iSee  : %d]", receivedSettings.iSee);
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[Mode  : %s]", MODE_MAP.nameAt(receivedSettings.mode));
 
-        if (this->firstRun) {
-            this->wantedSettings = receivedSettings;
-            this->wantedSettings.hasChanged = false;
-            this->wantedSettings.hasBeenSent = false;
-            this->wantedSettings.nb_deffered_requests = 0;       // reset the counter which is tested each update_request_interval in buildAndSendRequestsInfoPackets()
-
-            firstRun = false;
+        if (reply.highResTemperature) {
+            this->tempMode = true;
+            CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "tempMode is true");
         }
-        this->iSee_sensor->publish_state(receivedSettings.iSee);
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[Consigne °C: %f]", receivedSettings.getTemperature());
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[Fan: %s]", FAN_MAP.nameAt(receivedSettings.fan));
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[Vane: %s]", VANE_MAP.nameAt(receivedSettings.vane));
 
-        //this->settingsChanged(receivedSettings, "heatpumpUpdate");
-        this->heatpumpUpdate(receivedSettings);
+        this->wideVaneAdj = reply.wideVaneAdj;
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[wideVane: %s (adj:%d)]", WIDEVANE_MAP.nameAt(receivedSettings.wideVane), wideVaneAdj);
 
+        this->settingsReceived(receivedSettings);
     }
-
-
              break;
-    case 0x03: {
-        /* room temperature reading */
-        ESP_LOGD("Decoder", "[0x03 room temperature]");
-        //this->last_received_packet_sensor->publish_state("0x62-> 0x03: Data -> Room temperature");        
 
-        if (data[6] != 0x00) {
-            int temp = data[6];
-            temp -= 128;
-            receivedStatus.roomTemperature = (float)temp / 2;
-        } else {
-            receivedStatus.roomTemperature = lookupByteMapValue(ROOM_TEMP_MAP, ROOM_TEMP, 32, data[3]);
+    case 0x03:
+        /* room temperature reading */
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[0x03 room temperature]");
+        result = decodeRoomTemperature(this->data, this->dataLength, receivedStatus);
+        if (result != CODEC_TOO_SHORT) {
+            CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[Room °C: %f]", receivedStatus.getRoomTemperature());
+            statusDidChange = true;
         }
-        ESP_LOGD("Decoder", "[Room °C: %f]", receivedStatus.roomTemperature);
-
-        // no change with this packet to currentStatus for operating and compressorFrequency
-        receivedStatus.operating = currentStatus.operating;
-        receivedStatus.compressorFrequency = currentStatus.compressorFrequency;
-
-        statusDidChange = true;
-
-    }
-             break;
+        break;
 
     case 0x04:
         /* unknown */
-        ESP_LOGI("Decoder", "[0x04 is unknown]");
-        //this->last_received_packet_sensor->publish_state("0x62-> 0x04: Data -> Unknown");
+        CN105_LOGI(LOG_SUBSYSTEM_DECODER, "Decoder", "[0x04 is unknown]");
         break;
 
     case 0x05:
         /* timer packet */
-        ESP_LOGW("Decoder", "[0x05 is timer packet: not implemented]");
-        //this->last_received_packet_sensor->publish_state("0x62-> 0x05: Data -> Timer Packet");
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[0x05 is timer packet]");
+        result = decodeTimers(this->data, this->dataLength, receivedStatus.timers);
+        if (result != CODEC_TOO_SHORT) {
+            CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[Timers: %s, on: %d/%d min, off: %d/%d min]", TIMER_MODE_MAP.nameAt(receivedStatus.timers.mode),
+                receivedStatus.timers.onMinutesRemaining * TIMER_INCREMENT_MINUTES, receivedStatus.timers.onMinutesSet * TIMER_INCREMENT_MINUTES,
+                receivedStatus.timers.offMinutesRemaining * TIMER_INCREMENT_MINUTES, receivedStatus.timers.offMinutesSet * TIMER_INCREMENT_MINUTES);
+            statusDidChange = true;
+        }
         break;
 
-    case 0x06: {
+    case 0x06:
         /* status */
-        ESP_LOGD("Decoder", "[0x06 is status]");
-        //this->last_received_packet_sensor->publish_state("0x62-> 0x06: Data -> Heatpump Status");
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[0x06 is status]");
+        result = decodeStatus(this->data, this->dataLength, receivedStatus);
+        if (result != CODEC_TOO_SHORT) {
+            // reset counter (because a reply indicates it is connected)
+            this->nonResponseCounter = 0;
+            statusDidChange = true;
+        }
+        break;
 
-        // reset counter (because a reply indicates it is connected)
-        this->nonResponseCounter = 0;
-        receivedStatus.operating = data[4];
-        receivedStatus.compressorFrequency = data[3];
+    case 0x09:
+        /* standby mode (maybe?), the meaning of the bytes is not known yet */
+        if (this->dataLength > 4) {
+            CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[0x09 standby: %02X %02X]", data[3], data[4]);
+        }
+        break;
 
-        // no change with this packet to roomTemperature
-        receivedStatus.roomTemperature = currentStatus.roomTemperature;
+    case FUNCTIONS_GET_PART1:
+    case FUNCTIONS_GET_PART2:
+        CN105_LOGD(LOG_SUBSYSTEM_DECODER, "Decoder", "[Packet Functions 0x20 et 0x22]");
+        result = decodeFunctions(this->data, this->dataLength, this->functions);
+        break;
 
+    default:
+        this->health[HEALTH_UNKNOWN_DATA_TYPES]++;
+        ESP_LOGW("Decoder", "type de packet [%02X] <-- inconnu et inattendu", data[0]);
+        break;
+    }
 
-        statusDidChange = true;
-        // RCVD_PKT_STATUS;
+    if (result == CODEC_TOO_SHORT) {
+        ESP_LOGW("Decoder", "packet [%02X] has an unexpected length (%d bytes), ignored", data[0], this->dataLength);
+    } else if (result == CODEC_UNKNOWN_VALUE) {
+        ESP_LOGW("Decoder", "packet [%02X] contains unknown values, the first entry of their table is used", data[0]);
     }
-             break;
 
-    case 0x09:
-        /* unknown */
-        ESP_LOGD("Decoder", "[0x09 is unknown]");
-        //this->last_received_packet_sensor->publish_state("0x62-> 0x09: Data -> Unknown");
-        break;
-    case 0x20:
-    case 0x22: {
-        ESP_LOGD("Decoder", "[Packet Functions 0x20 et 0x22]");
-        //this->last_received_packet_sensor->publish_state("0x62-> 0x20/0x22: Data -> Packet functions");
-        if (dataLength == 0x10) {
-            if (data[0] == 0x20) {
-                functions.setData1(&data[1]);
-            } else {
-                functions.setData2(&data[1]);
-            }
+    if (statusDidChange) {
+        this->statusReceived(receivedStatus);
+    }
+}
 
-            // RCVD_PKT_FUNCTIONS;
-        }
+/**
+ * starts collecting the replies of a poll cycle
+*/
+void CN105Climate::beginSnapshot() {
+    this->snapshot.settings = this->currentSettings;
+    this->snapshot.status = this->currentStatus;
+    this->snapshot.hasSettings = false;
+    this->snapshot.hasStatus = false;
+    this->snapshot.startedMs = this->clock->nowMs();
+    this->snapshotInProgress = true;
+}
 
+/**
+ * called when the poll cycle is over: every reply has been received, or the last reply timeout
+ * has expired, or the cycle has been cancelled. What has been received is applied and published once.
+*/
+void CN105Climate::commitSnapshot() {
+    if (!this->snapshotInProgress) {
+        return;
     }
-             break;
+    this->snapshotInProgress = false;
 
-    default:
-        ESP_LOGW("Decoder", "type de packet [%02X] <-- inconnu et inattendu", data[0]);
-        //this->last_received_packet_sensor->publish_state("0x62-> ?? : Data -> Unknown");
-        break;
+    CN105_LOGD(LOG_SUBSYSTEM_DECODER, TAG, "committing snapshot (settings: %s, status: %s) collected in %" PRIu32 " ms",
+        YESNO(this->snapshot.hasSettings), YESNO(this->snapshot.hasStatus), (uint32_t)(this->clock->nowMs() - this->snapshot.startedMs));
+
+    this->publishHeld = true;
+    if (this->snapshot.hasSettings) {
+        this->settingsReceived(this->snapshot.settings);
+    }
+    if (this->snapshot.hasStatus) {
+        this->statusReceived(this->snapshot.status);
     }
+    this->publishHeld = false;
 
-    if (statusDidChange) {
-        this->statusChanged(receivedStatus);
+    if (this->snapshot.hasSettings || this->snapshot.hasStatus) {
+        this->lastSnapshotMs = this->clock->nowMs();
     }
+    if (this->publishPending) {
+        this->publishClimateState();
+    }
+}
+
+void CN105Climate::settingsReceived(heatpumpSettings& settings) {
+    if (this->snapshotInProgress) {
+        this->snapshot.settings = settings;
+        this->snapshot.hasSettings = true;
+        return;
+    }
+
+    if (this->firstRun) {
+        this->wantedSettings = settings;
+        this->wantedSettings.hasChanged = false;
+        this->wantedSettings.hasBeenSent = false;
+        this->wantedSettings.nb_deffered_requests = 0;       // reset the counter which is tested each update_request_interval in buildAndSendRequestsInfoPackets()
+        this->wantedSettings.dirtyFields = 0;
+        this->wantedSettings.sentFields = 0;
+
+        firstRun = false;
+    }
+    this->iSee_sensor->publish_state(settings.iSee);
+
+    //this->settingsChanged(receivedSettings, "heatpumpUpdate");
+    this->heatpumpUpdate(settings);
+}
+
+void CN105Climate::statusReceived(heatpumpStatus& status) {
+    if (this->snapshotInProgress) {
+        this->snapshot.status = status;
+        this->snapshot.hasStatus = true;
+        return;
+    }
+    this->statusChanged(status);
+}
+
+uint32_t CN105Climate::get_snapshot_age_ms() {
+    return (uint32_t)(this->clock->nowMs() - this->lastSnapshotMs);
 }
 
-void CN105Climate::updateSuccess() {
+/**
+ * request is the set packet this ACK answers, nullptr if it was not in flight anymore:
+ * then pending wanted settings are the best guess
+*/
+void CN105Climate::updateSuccess(const txTransaction* request) {
     ESP_LOGI(TAG, "Last heatpump data update successful!");
     //this->last_received_packet_sensor->publish_state("0x61: update success");
+
+    // the fields acknowledged are the ones written in this set packet: a later one, still queued,
+    // may carry other fields or other values
+    heatpumpSettings acked = this->currentSettings;
+    uint8_t ackedFields;
+    uint8_t setType;
+    if (request != nullptr) {
+        setType = request->type();
+        ackedFields = setType == SET_TYPE_SETTINGS ? decodeSettingsPacket(request->frame.bytes, acked) : 0;
+    } else {
+        ackedFields = this->wantedSettings.sentFields;
+        acked.merge(this->wantedSettings.sentValues, ackedFields);
+        setType = ackedFields != 0 ? SET_TYPE_SETTINGS : SET_TYPE_REMOTE_TEMP;
+    }
+    bool wantedSettingsPending = setType == SET_TYPE_SETTINGS && ackedFields != 0;
+
     // as the update was successful, we can set currentSettings to wantedSettings        
     // even if the next settings request will do the same.
-    if (this->wantedSettings.hasChanged) {
+    if (wantedSettingsPending) {
         ESP_LOGI(TAG, "And it was a wantedSetting ACK!");
-        this->wantedSettings.hasChanged = false;
-        this->wantedSettings.hasBeenSent = false;
-        this->wantedSettings.nb_deffered_requests = 0;       // reset the counter which is tested each update_request_interval in buildAndSendRequestsInfoPackets()
         //this->settingsChanged(this->wantedSettings, "WantedSettingsUpdateSuccess");
-        this->wantedSettingsUpdateSuccess(this->wantedSettings);
-    } else {
+        this->wantedSettingsUpdateSuccess(acked, ackedFields);
+        // fields asked again by the user while the packet was in flight are still dirty or sent
+        this->wantedSettings.acknowledge(acked, ackedFields);       // resets the counter which is tested each update_request_interval in buildAndSendRequestsInfoPackets()
+    } else if (setType == SET_TYPE_REMOTE_TEMP) {
         ESP_LOGI(TAG, "And it was a setExternalTemperature() ACK!");
         // sendind the remoteTemperature would have more sense but we don't know it
         // the hp will sent if later
         //this->settingsChanged(this->currentSettings, "ExtTempUpdateSuccess");
         this->extTempUpdateSuccess();
 
+    } else {
+        ESP_LOGI(TAG, "And it was the ACK of a [%02X] set packet", setType);
     }
     /*this->currentSettings.power = this->wantedSettings.power;
     this->currentSettings.mode = this->wantedSettings.mode;
@@ -309,10 +360,10 @@ void CN105Climate::updateSuccess() {
     }
 }
 
-void CN105Climate::processCommand() {
+void CN105Climate::processCommand(const txTransaction* request) {
     switch (this->command) {
     case 0x61:  /* last update was successful */
-        this->updateSuccess();
+        this->updateSuccess(request);
         break;
 
     case 0x62:  /* packet contains data (room °C, settings, timer, status, or functions...)*/
@@ -337,16 +388,17 @@ void CN105Climate::statusChanged(heatpumpStatus status) {
     if (status != currentStatus) {
         this->debugStatus("current", currentStatus);
     }
+    if (status.compressorFrequency != currentStatus.compressorFrequency) {
+        this->pollActivity("compressor frequency");
+    }
 
-    currentStatus.operating = status.operating;
-    currentStatus.compressorFrequency = status.compressorFrequency;
-    currentStatus.roomTemperature = status.roomTemperature;
-    this->current_temperature = currentStatus.roomTemperature;
+    currentStatus = status;
+    this->current_temperature = currentStatus.getRoomTemperature();
 
     this->updateAction();       // update action info on HA climate component
 
-    this->publish_state();
-    this->compressor_frequency_sensor->publish_state(currentStatus.compressorFrequency);
+    this->publishClimateState();
+    this->publishCompressorFrequency(currentStatus.compressorFrequency);
 }
 
 
@@ -356,42 +408,47 @@ void CN105Climate::publishStateToHA(heatpumpSettings settings) {
     checkFanSettings(settings);
     checkVaneSettings(settings);
     // HA Temp
-    this->target_temperature = settings.temperature;
+    this->target_temperature = settings.getTemperature();
 
     // CurrentSettings update
-    this->currentSettings.temperature = settings.temperature;
+    this->currentSettings.temperature2x = settings.temperature2x;
+    this->currentSettings.wideVane = settings.wideVane;
     this->currentSettings.iSee = settings.iSee;
     this->currentSettings.connected = true;
 
     // publish to HA
-    this->publish_state();
+    this->publishClimateState();
 
 }
 
 
-void CN105Climate::wantedSettingsUpdateSuccess(heatpumpSettings settings) {
-    // settings correponds to fresh wanted settings
-    ESP_LOGD(LOG_ACTION_EVT_TAG, "WantedSettings update success");
+void CN105Climate::wantedSettingsUpdateSuccess(const heatpumpSettings& settings, uint8_t fields) {
+    // only the fields carried by the set packet have been applied by the heatpump
+    CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "WantedSettings update success (fields 0x%02X)", fields);
+    heatpumpSettings applied = this->currentSettings;
+    applied.merge(settings, fields);
+    this->commandApplied = this->commandStartedMs != 0;
+
     // update HA states thanks to wantedSettings
-    this->publishStateToHA(settings);
+    this->publishStateToHA(applied);
 
     // as wantedSettings has been received with ACK by the heatpump
     // we can update the surrentSettings
-    this->currentSettings = this->wantedSettings;
+    this->currentSettings.merge(settings, fields);
     this->debugSettings("current", currentSettings);
 }
 
 void CN105Climate::extTempUpdateSuccess() {
-    ESP_LOGD(LOG_ACTION_EVT_TAG, "External C° update success");
+    CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "External C° update success");
     // can retreive room °C from currentStatus.roomTemperature because 
     // set_remote_temperature() is optimistic and has recorded it 
-    this->current_temperature = currentStatus.roomTemperature;
-    this->publish_state();
+    this->current_temperature = currentStatus.getRoomTemperature();
+    this->publishClimateState();
 }
 
 void CN105Climate::heatpumpUpdate(heatpumpSettings settings) {
     // settings correponds to current settings 
-    ESP_LOGD(LOG_ACTION_EVT_TAG, "Settings received");
+    CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "Settings received");
 
     heatpumpSettings& wanted = wantedSettings;  // for casting purpose
     if (settings == wanted) {
@@ -405,6 +462,8 @@ void CN105Climate::heatpumpUpdate(heatpumpSettings settings) {
         wantedSettings.hasChanged = false;
         this->wantedSettings.hasBeenSent = false;
         this->wantedSettings.nb_deffered_requests = 0;
+        this->wantedSettings.dirtyFields = 0;
+        this->wantedSettings.sentFields = 0;
     } else {
         this->debugSettings("current", this->currentSettings);
         this->debugSettings("wanted", this->wantedSettings);
@@ -414,12 +473,15 @@ void CN105Climate::heatpumpUpdate(heatpumpSettings settings) {
         if (wantedSettings.hasChanged) {
             this->debugSettings("received", settings);
             // it's because user did ask a change throuth HA
-            // we have nothing to do, because this change will trigger a packet send from 
-            // the loop() method
+            // the change will trigger a packet send from the loop() method, which only carries
+            // the dirty fields: the other ones follow the heatpump (they may come from the IR remote),
+            // except the ones of a set packet not acknowledged yet
             ESP_LOGW(LOG_ACTION_EVT_TAG, "wantedSettings is true, and we received an info packet");
+            this->wantedSettings.merge(settings, SETTINGS_FIELD_ALL & ~(this->wantedSettings.dirtyFields | this->wantedSettings.sentFields));
         } else {
 
             // it's because of an IR remote control update
+            this->pollActivity("IR remote");
             this->publishStateToHA(settings);
             this->debugSettings("receivedIR", settings);
         }
@@ -432,7 +494,7 @@ void CN105Climate::settingsChanged(heatpumpSettings settings, const char* source
 
     if (strcmp(source, "WantedSettingsUpdateSuccess") == 0) {
         // settings correponds to fresh wanted settings
-        ESP_LOGD(LOG_ACTION_EVT_TAG, "WantedSettings update success");
+        CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "WantedSettings update success");
         // update HA states thanks to wantedSettings
         this->publishStateToHA(settings);
 
@@ -444,7 +506,7 @@ void CN105Climate::settingsChanged(heatpumpSettings settings, const char* source
 
     if (strcmp(source, "ExtTempUpdateSuccess")) {
         // settings correponds to current settings but that's not important
-        ESP_LOGD(LOG_ACTION_EVT_TAG, "External C° update success");
+        CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "External C° update success");
         // can retreive room °C from currentStatus.roomTemperature because
         // set_remote_temperature() is optimistic and has recorded it
         this->current_temperature = currentStatus.roomTemperature;
@@ -452,7 +514,7 @@ void CN105Climate::settingsChanged(heatpumpSettings settings, const char* source
 
     if (strcmp(source, "heatpumpUpdate")) {
         // settings correponds to current settings
-        ESP_LOGD(LOG_ACTION_EVT_TAG, "Settings received");
+        CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "Settings received");
 
         heatpumpSettings& wanted = wantedSettings;  // for casting purpose
         if (wanted == settings) {
@@ -484,13 +546,14 @@ void CN105Climate::settingsChanged(heatpumpSettings settings, const char* source
 
 void CN105Climate::checkVaneSettings(heatpumpSettings& settings) {
     /* ******** HANDLE MITSUBISHI VANE CHANGES ********
-         * const char* VANE_MAP[7]        = {"AUTO", "1", "2", "3", "4", "5", "SWING"};
+         * VANE_MAP = {"AUTO", "1", "2", "3", "4", "5", "SWING"};
          */
-    if (this->hasChanged(currentSettings.vane, settings.vane, "vane")) { // vane setting change ?
+         // !currentSettings.connected is true when it is the first time we get en answer from hp
+    if (!currentSettings.connected || currentSettings.vane != settings.vane) { // vane setting change ?
         ESP_LOGI(TAG, "vane setting changed");
         currentSettings.vane = settings.vane;
 
-        if (strcmp(currentSettings.vane, "SWING") == 0) {
+        if (currentSettings.vane == HP_VANE_SWING) {
             this->swing_mode = climate::CLIMATE_SWING_VERTICAL;
         } else {
             this->swing_mode = climate::CLIMATE_SWING_OFF;
@@ -498,66 +561,76 @@ void CN105Climate::checkVaneSettings(heatpumpSettings& settings) {
         ESP_LOGD(TAG, "Swing mode is: %i", this->swing_mode);
     }
 
-    if (this->hasChanged(this->vane->state.c_str(), settings.vane, "select vane")) {
+    if (this->vane->state != VANE_MAP.nameAt(settings.vane)) {
         ESP_LOGI(TAG, "vane setting (extra select component) changed");
-        this->vane->publish_state(currentSettings.vane);
+        this->vane->publish_state(VANE_MAP.nameAt(currentSettings.vane));
     }
 }
 void CN105Climate::checkFanSettings(heatpumpSettings& settings) {
     /*
          * ******* HANDLE FAN CHANGES ********
          *
-         * const char* FAN_MAP[6]         = {"AUTO", "QUIET", "1", "2", "3", "4"};
+         * FAN_MAP = {"AUTO", "QUIET", "1", "2", "3", "4"};
          */
-         // currentSettings.fan== NULL is true when it is the first time we get en answer from hp
+         // !currentSettings.connected is true when it is the first time we get en answer from hp
 
-    if (this->hasChanged(currentSettings.fan, settings.fan, "fan")) { // fan setting change ?
+    if (!currentSettings.connected || currentSettings.fan != settings.fan) { // fan setting change ?
         ESP_LOGI(TAG, "fan setting changed");
         currentSettings.fan = settings.fan;
-        if (strcmp(currentSettings.fan, "QUIET") == 0) {
+        switch (currentSettings.fan) {
+        case HP_FAN_QUIET:
             this->fan_mode = climate::CLIMATE_FAN_QUIET;
-        } else if (strcmp(currentSettings.fan, "1") == 0) {
+            break;
+        case HP_FAN_1:
             this->fan_mode = climate::CLIMATE_FAN_LOW;
-        } else if (strcmp(currentSettings.fan, "2") == 0) {
+            break;
+        case HP_FAN_2:
             this->fan_mode = climate::CLIMATE_FAN_MEDIUM;
-        } else if (strcmp(currentSettings.fan, "3") == 0) {
+            break;
+        case HP_FAN_3:
             this->fan_mode = climate::CLIMATE_FAN_MIDDLE;
-        } else if (strcmp(currentSettings.fan, "4") == 0) {
+            break;
+        case HP_FAN_4:
             this->fan_mode = climate::CLIMATE_FAN_HIGH;
-        } else { //case "AUTO" or default:
+            break;
+        default: //case "AUTO" or default:
             this->fan_mode = climate::CLIMATE_FAN_AUTO;
+            break;
         }
-        ESP_LOGD(TAG, "Fan mode is: %i", this->fan_mode);
+        ESP_LOGD(TAG, "Fan mode is: %i", this->fan_mode.value());
     }
 }
 void CN105Climate::checkPowerAndModeSettings(heatpumpSettings& settings) {
-    // currentSettings.power== NULL is true when it is the first time we get en answer from hp
-    if (this->hasChanged(currentSettings.power, settings.power, "power") ||
-        this->hasChanged(currentSettings.mode, settings.mode, "mode")) {           // mode or power change ?
+    // !currentSettings.connected is true when it is the first time we get en answer from hp
+    if (!currentSettings.connected ||
+        currentSettings.power != settings.power ||
+        currentSettings.mode != settings.mode) {           // mode or power change ?
 
         ESP_LOGI(TAG, "power or mode changed");
         currentSettings.power = settings.power;
         currentSettings.mode = settings.mode;
 
-        if (strcmp(currentSettings.power, "ON") == 0) {
-            if (strcmp(currentSettings.mode, "HEAT") == 0) {
+        if (currentSettings.power == HP_POWER_ON) {
+            switch (currentSettings.mode) {
+            case HP_MODE_HEAT:
                 this->mode = climate::CLIMATE_MODE_HEAT;
-            } else if (strcmp(currentSettings.mode, "DRY") == 0) {
+                break;
+            case HP_MODE_DRY:
                 this->mode = climate::CLIMATE_MODE_DRY;
-            } else if (strcmp(currentSettings.mode, "COOL") == 0) {
+                break;
+            case HP_MODE_COOL:
                 this->mode = climate::CLIMATE_MODE_COOL;
-                /*if (cool_setpoint != currentSettings.temperature) {
-                    cool_setpoint = currentSettings.temperature;
-                    save(currentSettings.temperature, cool_storage);
-                }*/
-            } else if (strcmp(currentSettings.mode, "FAN") == 0) {
+                break;
+            case HP_MODE_FAN:
                 this->mode = climate::CLIMATE_MODE_FAN_ONLY;
-            } else if (strcmp(currentSettings.mode, "AUTO") == 0) {
+                break;
+            case HP_MODE_AUTO:
                 this->mode = climate::CLIMATE_MODE_HEAT_COOL;
-            } else {
+                break;
+            default:
                 ESP_LOGW(
                     TAG,
-                    "Unknown climate mode value %s received from HeatPump",
+                    "Unknown climate mode value %d received from HeatPump",
                     currentSettings.mode
                 );
             }
@@ -566,4 +639,3 @@ void CN105Climate::checkPowerAndModeSettings(heatpumpSettings& settings) {
         }
     }
 }
-
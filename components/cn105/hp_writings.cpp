@@ -1,41 +1,25 @@
 #include "cn105.h"
 
-
-
-byte CN105Climate::checkSum(uint8_t bytes[], int len) {
-    uint8_t sum = 0;
-    for (int i = 0; i < len; i++) {
-        sum += bytes[i];
-    }
-    return (0xfc - sum) & 0xff;
-}
-
-
 void CN105Climate::sendFirstConnectionPacket() {
     if (this->isConnected_) {
         this->isHeatpumpConnected_ = false;
 
-        ESP_LOGD(TAG, "Envoi du packet de connexion...");
+        CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "Envoi du packet de connexion...");
         uint8_t packet[CONNECT_LEN];
-        memcpy(packet, CONNECT, CONNECT_LEN);
+        size_t length = encodeConnectPacket(packet, sizeof(packet));
         //for(int count = 0; count < 2; count++) {
 
-        this->writePacket(packet, CONNECT_LEN, false);      // checkIsActive=false because it's the first packet and we don't have any reply yet
+        this->txQueue.abandonInFlight();    // a pending exchange will never complete
+        this->wantedSettings.sendAgain(this->wantedSettings.sentFields, this->currentSettings);
+        this->writePacket(packet, length, TX_PRIORITY_CONNECT, false);      // checkIsActive=false because it's the first packet and we don't have any reply yet
 
-        lastSend = CUSTOM_MILLIS;
-
-        // we wait for a 4s timeout to check if the hp has replied to connection packet
-        this->set_timeout("checkFirstConnection", 4000, [this]() {
-            if (!this->isHeatpumpConnected_) {
-                ESP_LOGE(TAG, "--> Heatpump did not reply: NOT CONNECTED <--");
-            } else {
-                // not usefull because the response has been processed in processCommand()
-            }
-
-            });
+        lastSend = this->clock->nowMs();
+        // without reply, the connect packet is retransmitted, then transactionFailed() reports it
 
     } else {
         ESP_LOGE(TAG, "Vous devez dabord connecter l'appareil via l'UART");
+        // no connect packet will fail: nothing else would try again
+        this->programConnectRetry(HEALTH_RECONNECTS_INACTIVE);
     }
 }
 
@@ -43,111 +27,193 @@ void CN105Climate::sendFirstConnectionPacket() {
 
 
 void CN105Climate::statusChanged() {
-    ESP_LOGD(TAG, "hpStatusChanged ->");
-    this->current_temperature = currentStatus.roomTemperature;
+    CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "hpStatusChanged ->");
+    this->current_temperature = currentStatus.getRoomTemperature();
 
-    ESP_LOGD(TAG, "t°: %f", currentStatus.roomTemperature);
-    ESP_LOGD(TAG, "operating: %d", currentStatus.operating);
-    ESP_LOGD(TAG, "compressor freq: %d", currentStatus.compressorFrequency);
+    CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "t°: %f", currentStatus.getRoomTemperature());
+    CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "operating: %d", currentStatus.operating);
+    CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "compressor freq: %d", currentStatus.compressorFrequency);
 
     this->updateAction();
-    this->publish_state();
+    this->publishClimateState();
 }
 
-void CN105Climate::prepareInfoPacket(uint8_t* packet, int length) {
-    ESP_LOGV(TAG, "preparing info packet...");
-
-    memset(packet, 0, length * sizeof(uint8_t));
-
-    for (int i = 0; i < INFOHEADER_LEN && i < length; i++) {
-        packet[i] = INFOHEADER[i];
+/**
+ * queues a packet: it is copied, so packet can be a local buffer of the caller
+ * processTxQueue() sends it when its turn comes
+*/
+bool CN105Climate::writePacket(const uint8_t* packet, int length, txPriority priority, bool checkIsActive) {
+    if (!this->txQueue.push(packet, length, priority, checkIsActive)) {
+        this->health[HEALTH_DROPPED_WRITES]++;
+        ESP_LOGW(TAG, "TX queue is full, packet (%02X %02X) dropped", packet[1], length > 5 ? packet[5] : 0);
+        return false;
     }
+    return true;
 }
 
-void CN105Climate::prepareSetPacket(uint8_t* packet, int length) {
-    ESP_LOGV(TAG, "preparing Set packet...");
-    memset(packet, 0, length * sizeof(uint8_t));
-
-    for (int i = 0; i < HEADER_LEN && i < length; i++) {
-        packet[i] = HEADER[i];
+/**
+ * called by loop(): writes the most urgent queued packet once the previous exchange is over
+ * and the UART has room for the whole packet
+*/
+void CN105Climate::processTxQueue() {
+    this->txQueue.expire(this->clock->nowMs(), [this](const txTransaction& transaction) {
+        this->roundTripTimes.timedOut(transaction.command(), transaction.type());
+        }, [this](const txTransaction& transaction) {
+            this->transactionFailed(transaction);
+        });
+    if (!this->txQueue.ready()) {
+        return;     // waiting for the reply to the previous packet
     }
-}
 
-void CN105Climate::writePacket(uint8_t* packet, int length, bool checkIsActive) {
+    const txFrame* frame = this->txQueue.peek();
+    if (frame == nullptr) {
+        return;
+    }
 
     if ((this->isConnected_) &&
-        (this->isHeatpumpConnectionActive() || (!checkIsActive))) {
-
-        if (this->get_hw_serial_()->availableForWrite() >= length) {
-            ESP_LOGD(TAG, "writing packet...");
-            this->hpPacketDebug(packet, length, "WRITE");
-
-            for (int i = 0; i < length; i++) {
-                this->get_hw_serial_()->write((uint8_t)packet[i]);
+        (this->isHeatpumpConnectionActive() || (!frame->checkIsActive))) {
+
+        int room = this->transport->availableForWrite();
+        if (room < 0) {
+            this->transportLost("is closed");
+        } else if (room >= frame->length) {
+            CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "writing packet...");
+            this->hpPacketDebug(frame->bytes, frame->length, "WRITE", LOG_SUBSYSTEM_WRITER);
+
+            // the timeout runs from the end of the transmission, at the round trip time of this kind of request
+            uint64_t nowUs = this->clock->nowUs();
+            uint32_t wireUs = this->wireTimeUs(frame->length);
+            uint32_t timeoutMs = this->roundTripTimes.of(frame->bytes[1], frame->bytes[5]).timeoutMs() + (wireUs + 999) / 1000;
+
+            size_t written = this->transport->write(frame->bytes, frame->length);
+            if (written != frame->length) {
+                // the frame stays queued: it is sent whole on the link opened again, a cut one gets no reply
+                this->health[HEALTH_FAILED_WRITES]++;
+                ESP_LOGW(TAG, "packet (%02X %02X) written short: %d of %d bytes", frame->bytes[1], frame->bytes[5], (int)written, frame->length);
+                this->transportLost("write failed");
+                return;
             }
+            this->trace.record((uint32_t)nowUs, true, frame->bytes, frame->length);
+            switch (frame->bytes[1]) {
+            case 0x41: this->health[HEALTH_TX_SET]++; break;
+            case 0x42: this->health[HEALTH_TX_INFO]++; break;
+            case 0x5A: this->health[HEALTH_TX_CONNECT]++; break;
+            default: break;
+            }
+            this->txQueue.sent(frame, this->clock->nowMs(), timeoutMs, nowUs + wireUs);
         } else {
-            ESP_LOGW(TAG, "delaying packet writing because serial buffer is not ready...");
-            this->set_timeout("write", 200, [this, packet, length]() { this->writePacket(packet, length); });
+            CN105_LOGV(LOG_SUBSYSTEM_WRITER, TAG, "delaying packet writing because %s buffer is not ready...", this->transport->name());
+            if (this->lastDeferredSequence != frame->sequence + 1) {
+                this->lastDeferredSequence = frame->sequence + 1;      // + 1: 0 is no frame
+                this->health[HEALTH_DEFERRED_WRITES]++;
+            }
         }
-    } else {
+    } else if (!this->connectRetryPending) {
         ESP_LOGW(TAG, "could not write as asked, because UART is not connected");
-        this->disconnectUART();
-        this->setupUART();
-        this->sendFirstConnectionPacket();
-
-        ESP_LOGW(TAG, "delaying packet writing because we need to reconnect first...");
-        this->set_timeout("write", 500, [this, packet, length]() { this->writePacket(packet, length); });
+        // the queued packets are kept, they will be sent after the connect packet
+        this->programConnectRetry(HEALTH_RECONNECTS_INACTIVE);
     }
 }
 
-void CN105Climate::createPacket(byte* packet, heatpumpSettings settings) {
-    prepareSetPacket(packet, PACKET_LEN);
+/**
+ * the transport can no longer carry frames (e.g. a TCP connection which failed): the queued
+ * frames are kept and the link is opened again at the next reconnection tick
+*/
+void CN105Climate::transportLost(const char* reason) {
+    ESP_LOGW(TAG, "%s %s, the link will be opened again", this->transport->name(), reason);
+    this->isConnected_ = false;
+    this->programConnectRetry(HEALTH_RECONNECTS_INACTIVE);
+}
 
-    ESP_LOGD(TAG, "checking differences bw asked settings and current ones...");
+/**
+ * the connection is tried again after a poll interval, not at each loop(): a transport which
+ * cannot be opened (e.g. an unreachable TCP bridge) would keep the ESP busy
+*/
+void CN105Climate::programConnectRetry(healthCounter cause) {
+    if (this->connectRetryPending) {
+        return;
+    }
+    this->connectRetryPending = true;
+    this->set_timeout(CONNECT_RETRY_NAME, this->pollIntervalMs > 0 ? this->pollIntervalMs : PACKET_INFO_INTERVAL_MS, [this, cause]() {
+        this->connectRetryPending = false;
+        if (this->isHeatpumpConnectionActive()) {
+            return;     // the heatpump came back meanwhile
+        }
+        this->health[cause]++;
+        this->reconnectUART();
+        });
+}
 
+/**
+ * called by processTxQueue() when a request is still without reply after TX_MAX_RETRIES retransmissions
+ * only MAX_FAILED_TRANSACTIONS consecutive failures are worth a reconnection
+*/
+void CN105Climate::transactionFailed(const txTransaction& transaction) {
+    ESP_LOGW(TAG, "no reply to packet (%02X %02X) after %d attempts", transaction.command(), transaction.type(), transaction.frame.retries + 1);
+
+    switch (transaction.command()) {
+    case 0x5A:
+        ESP_LOGE(TAG, "--> Heatpump did not reply: NOT CONNECTED <--");
+        // the poll cycles are skipped until the connection is established: nothing else would try again
+        this->programConnectRetry(HEALTH_RECONNECTS_NO_REPLY);
+        return;
+    case 0x42:
+        if (this->awaitedInfoType == transaction.type()) {
+            // the poll cycle goes on without this reply
+            this->cancel_timeout(POLL_REPLY_TIMEOUT_NAME);
+            this->sendNextPollRequest();
+        }
+        break;
+    case 0x41:
+        if (transaction.type() == SET_TYPE_SETTINGS) {
+            // checkPendingWantedSettings() will build it again from the wanted settings
+            heatpumpSettings lost = this->currentSettings;
+            this->wantedSettings.sendAgain(decodeSettingsPacket(transaction.frame.bytes, lost), this->currentSettings);
+        }
+        break;
+    default:
+        break;
+    }
 
+    if (++this->failedTransactions >= MAX_FAILED_TRANSACTIONS) {
+        ESP_LOGW(TAG, "%d requests in a row without reply, reconnecting", this->failedTransactions);
+        this->health[HEALTH_RECONNECTS_NO_REPLY]++;
+        this->failedTransactions = 0;
+        this->reconnectUART();
+    }
+}
 
-    //if (this->hasChanged(currentSettings.power, settings.power, "power (wantedSettings)")) {
-    ESP_LOGD(TAG, "power is always set -> %s", settings.power);
-    packet[8] = POWER[lookupByteMapIndex(POWER_MAP, 2, settings.power)];
-    packet[6] += CONTROL_PACKET_1[0];
-    //}
+/**
+ * only the SETTINGS_FIELD_* flagged in fields are written in the packet: the heatpump
+ * leaves the other ones untouched, so a fan or vane change made with the IR remote is not
+ * overwritten by a setpoint change
+*/
+void CN105Climate::createPacket(uint8_t* packet, const heatpumpSettings& settings, uint8_t fields) {
+    CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "building set packet for fields 0x%02X", fields);
 
-    //if (this->hasChanged(currentSettings.mode, settings.mode, "mode (wantedSettings)")) {
-    ESP_LOGD(TAG, "heatpump mode changed -> %s", settings.mode);
-    packet[9] = MODE[lookupByteMapIndex(MODE_MAP, 5, settings.mode)];
-    packet[6] += CONTROL_PACKET_1[1];
-    //}
-    //if (!tempMode && settings.temperature != currentSettings.temperature) {
-    if (!tempMode) {
-        ESP_LOGD(TAG, "temperature changed (tempmode is false) -> %f", settings.temperature);
-        packet[10] = TEMP[lookupByteMapIndex(TEMP_MAP, 16, settings.temperature)];
-        packet[6] += CONTROL_PACKET_1[2];
-        //} else if (tempMode && settings.temperature != currentSettings.temperature) {
-    } else {
-        ESP_LOGD(TAG, "temperature changed (tempmode is true) -> %f", settings.temperature);
-        float temp = (settings.temperature * 2) + 128;
-        packet[19] = (int)temp;
-        packet[6] += CONTROL_PACKET_1[2];
+    if (fields & SETTINGS_FIELD_POWER) {
+        CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "heatpump power changed -> %s", POWER_MAP.nameAt(settings.power));
+    }
+    if (fields & SETTINGS_FIELD_MODE) {
+        CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "heatpump mode changed -> %s", MODE_MAP.nameAt(settings.mode));
+    }
+    if (fields & SETTINGS_FIELD_TEMP) {
+        CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "temperature changed (tempmode is %s) -> %f", this->tempMode ? "true" : "false", settings.getTemperature());
+        if (!this->tempMode && TEMP_MAP.indexOfValue((int)settings.getTemperature()) == -1) {
+            ESP_LOGW(TAG, "temperature %f cannot be encoded without tempMode, %d will be sent", settings.getTemperature(), TEMP_MAP.valueAt(0));
+        }
+    }
+    if (fields & SETTINGS_FIELD_FAN) {
+        CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "heatpump fan changed -> %s", FAN_MAP.nameAt(settings.fan));
+    }
+    if (fields & SETTINGS_FIELD_VANE) {
+        CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "heatpump vane changed -> %s", VANE_MAP.nameAt(settings.vane));
+    }
+    if (fields & SETTINGS_FIELD_WIDEVANE) {
+        CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "heatpump widevane changed -> %s", WIDEVANE_MAP.nameAt(settings.wideVane));
     }
 
-    //if (this->hasChanged(currentSettings.fan, settings.fan, "fan (wantedSettings)")) {
-    ESP_LOGD(TAG, "heatpump fan changed -> %s", settings.fan);
-    packet[11] = FAN[lookupByteMapIndex(FAN_MAP, 6, settings.fan)];
-    packet[6] += CONTROL_PACKET_1[3];
-    //}
-
-    //if (this->hasChanged(currentSettings.vane, settings.vane, "vane (wantedSettings)")) {
-    ESP_LOGD(TAG, "heatpump vane changed -> %s", settings.vane);
-    packet[12] = VANE[lookupByteMapIndex(VANE_MAP, 7, settings.vane)];
-    packet[6] += CONTROL_PACKET_1[4];
-    //}
-
-    // add the checksum
-    uint8_t chkSum = checkSum(packet, 21);
-    packet[21] = chkSum;
-    //ESP_LOGD(TAG, "debug before write packet:");
-    //this->hpPacketDebug(packet, 22, "WRITE");
+    encodeSettingsPacket(packet, PACKET_LEN, settings, fields, this->tempMode, this->wideVaneAdj);
 }
 
 /**
@@ -159,28 +225,31 @@ void CN105Climate::createPacket(byte* packet, heatpumpSettings settings) {
 void CN105Climate::sendWantedSettings() {
 
     if (this->isHeatpumpConnectionActive() && this->isConnected_) {
-        if (CUSTOM_MILLIS - this->lastSend > 500) {        // we don't want to send too many packets
+        if (this->clock->nowMs() - this->lastSend > 500) {        // we don't want to send too many packets
 
-            this->wantedSettings.hasBeenSent = true;
-            this->lastSend = CUSTOM_MILLIS;
-            ESP_LOGI(TAG, "sending wantedSettings..");
+            this->lastSend = this->clock->nowMs();
+            ESP_LOGI(TAG, "sending wantedSettings (%" PRIu32 " control calls, %" PRIu32 " merged since boot)..", this->pendingCommands, this->health[HEALTH_COALESCED_COMMANDS]);
+            this->pendingCommands = 0;
 
             this->debugSettings("wantedSettings", wantedSettings);
 
             if (this->autoUpdate) {
-                ESP_LOGD(TAG, "cancelling the update loop during the push of the settings..");
+                CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "cancelling the update loop during the push of the settings..");
                 /*  we don't want the autoupdate loop to interfere with this packet communication
                     So we first cancel the SHEDULER_INTERVAL_SYNC_NAME */
                 this->cancel_timeout(SHEDULER_INTERVAL_SYNC_NAME);
-                this->cancel_timeout("2ndPacket");
-                this->cancel_timeout("3rdPacket");
             }
+            // the replies to a pending poll cycle would be mixed up with the ACK
+            this->cancelPollCycle();
 
             // and then we send the update packet
+            // the fields still waiting for their ACK are written again: this packet replaces
+            // a previous one still in the queue, and the values are the same anyway
             byte packet[PACKET_LEN] = {};
-            this->createPacket(packet, wantedSettings);
-            this->writePacket(packet, PACKET_LEN);
-            this->hpPacketDebug(packet, 22, "WRITE_SETTINGS");
+            this->createPacket(packet, wantedSettings, wantedSettings.dirtyFields | wantedSettings.sentFields);
+            if (this->writePacket(packet, PACKET_LEN, TX_PRIORITY_SET)) {
+                this->wantedSettings.markSent();
+            }
 
             // here we know the update packet has been sent but we don't know if it has been received
             // so we have to program a check to be sure we will get a response
@@ -198,7 +267,7 @@ void CN105Climate::sendWantedSettings() {
                 });
 
         } else {
-            ESP_LOGD(TAG, "will sendWantedSettings later because we've sent one too recently...");
+            CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "will sendWantedSettings later because we've sent one too recently...");
         }
     }
 
@@ -232,11 +301,13 @@ void CN105Climate::programResponseCheck(int packetType) {
         //getDataFromResponsePacket() method case 0x06
         this->nonResponseCounter++;
 
-        this->set_timeout("checkpacketResponse", this->update_interval_ * 0.9, [this]() {
+        // the status reply is late once its retransmissions are over too
+        this->set_timeout("checkpacketResponse", this->replyBudgetMs(0x42, INFOMODE[packetType]), [this]() {
 
             if (this->nonResponseCounter > MAX_NON_RESPONSE_REQ) {
                 ESP_LOGI(TAG, "There are too many status resquests without response: %d of max %d", this->nonResponseCounter, MAX_NON_RESPONSE_REQ);
                 ESP_LOGI(TAG, "Heater is not connected anymore");
+                this->health[HEALTH_RECONNECTS_STATUS]++;
                 this->disconnectUART();
                 this->setupUART();
                 this->sendFirstConnectionPacket();
@@ -250,41 +321,48 @@ void CN105Climate::programResponseCheck(int packetType) {
 void CN105Climate::buildAndSendRequestPacket(int packetType) {
     uint8_t packet[PACKET_LEN] = {};
     createInfoPacket(packet, packetType);
-    this->writePacket(packet, PACKET_LEN);
+    this->writePacket(packet, PACKET_LEN, TX_PRIORITY_POLL);
 }
 
 
 /**
  * builds ans send all 3 types of packet to get a full informations back from heatpump
- * 3 packets are sent at 300 ms interval
+ * the requests are pipelined: the next one is sent as soon as the reply to the previous one
+ * has been processed, or when transactionFailed() gives up on it
 */
 void CN105Climate::buildAndSendRequestsInfoPackets() {
 
-    ESP_LOGD("CONTROL_WANTED_SETTINGS", "buildAndSendRequestsInfoPackets() wantedSettings.hasChanged is %s", wantedSettings.hasChanged ? "true" : "false");
+    CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, "CONTROL_WANTED_SETTINGS", "buildAndSendRequestsInfoPackets() wantedSettings.hasChanged is %s", wantedSettings.hasChanged ? "true" : "false");
 
     if (!wantedSettings.hasChanged) {       // we don't want to interfere with the update settings process, this is a user command
 
         if (this->isHeatpumpConnected_) {
 
-            uint32_t interval = 300;
-            if (this->update_interval_ > 0) {
-                // we get the max interval of update_interval_ / 4 or interval (300)
-                interval = (this->update_interval_ / 4) > interval ? interval : (this->update_interval_ / 4);
+            if (this->awaitedInfoType != -1) {
+                ESP_LOGW(TAG, "buildAndSendRequestsInfoPackets: previous poll cycle is still waiting for [%02X], skipping this one", this->awaitedInfoType);
+            } else {
+                // only the request types whose period has elapsed are part of this cycle
+                this->pollRequestsCount = 0;
+                for (int packetType = 0; packetType < INFOMODE_LEN; packetType++) {
+                    if (this->isPollDue(packetType)) {
+                        this->pollRequests[this->pollRequestsCount++] = packetType;
+                        this->lastPolledMs[packetType] = this->clock->nowMs();
+                        this->polledOnce[packetType] = true;
+                    }
+                }
+                this->pollRequestIndex = 0;
+
+                if (this->snapshot_age_sensor != nullptr && this->lastSnapshotMs != 0) {
+                    this->snapshot_age_sensor->publish_state(this->get_snapshot_age_ms() / 1000.0f);
+                }
+                if (this->pollRequestsCount > 0) {
+                    this->beginSnapshot();
+                }
+
+                CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "buildAndSendRequestsInfoPackets: sending %d request packets", this->pollRequestsCount);
+                this->sendNextPollRequest();
             }
 
-            ESP_LOGD(TAG, "buildAndSendRequestsInfoPackets: sending 3 request packet at interval: %d", interval);
-
-            ESP_LOGD(TAG, "sending a request for settings packet (0x02)");
-            this->buildAndSendRequestPacket(RQST_PKT_SETTINGS);
-            this->set_timeout("2ndPacket", interval, [this, interval]() {
-                ESP_LOGD(TAG, "sending a request room temp packet (0x03)");
-                this->buildAndSendRequestPacket(RQST_PKT_ROOM_TEMP);
-                this->set_timeout("3rdPacket", interval, [this]() {
-                    ESP_LOGD(TAG, "sending a request status paquet (0x06)");
-                    this->buildAndSendRequestPacket(RQST_PKT_STATUS);
-                    });
-                });
-
         } else {
             ESP_LOGE(TAG, "sync impossible: heatpump not connected");
             //this->setupUART();
@@ -298,7 +376,7 @@ void CN105Climate::buildAndSendRequestsInfoPackets() {
         // over and over again.
         // In this case with have to set a limit to the number of deffered requests here
 
-        ESP_LOGD("CONTROL_WANTED_SETTINGS", "deffering requestInfo because wantedSettings.hasChanged is true");
+        CN105_LOGD(LOG_SUBSYSTEM_SETTINGS, "CONTROL_WANTED_SETTINGS", "deffering requestInfo because wantedSettings.hasChanged is true");
 
         wantedSettings.nb_deffered_requests++;
 
@@ -306,28 +384,95 @@ void CN105Climate::buildAndSendRequestsInfoPackets() {
             ESP_LOGW(TAG, "update success ACK was never received or never sent");
             ESP_LOGW(TAG, "we're probably not connected to heatpump anymore");
             wantedSettings.nb_deffered_requests = 0;
+            this->health[HEALTH_RECONNECTS_ACK]++;
             this->reconnectUART();
         }
     }
     this->programUpdateInterval();
 }
 
+bool CN105Climate::isPollDue(int packetType) {
+    uint32_t period = this->pollPeriodsMs[packetType];
 
+    if (period == POLL_PERIOD_NEVER) {
+        return false;
+    }
+    if ((packetType == RQST_PKT_ROOM_TEMP) && this->remoteTemperatureActive) {
+        return false;
+    }
+    if ((period == POLL_PERIOD_EVERY_CYCLE) || !this->polledOnce[packetType]) {
+        return true;
+    }
+    return (this->clock->nowMs() - this->lastPolledMs[packetType]) >= period;
+}
 
+void CN105Climate::set_poll_period(int packetType, uint32_t period_ms) {
+    if (packetType >= 0 && packetType < INFOMODE_LEN) {
+        this->pollPeriodsMs[packetType] = period_ms;
+    }
+}
 
-void CN105Climate::createInfoPacket(uint8_t* packet, uint8_t packetType) {
-    ESP_LOGD(TAG, "creating Info packet");
-    // add the header to the packet
-    for (int i = 0; i < INFOHEADER_LEN; i++) {
-        packet[i] = INFOHEADER[i];
+/**
+ * sends the next request of the current poll cycle and arms the reply timeout
+ * when the cycle is over, awaitedInfoType is set back to -1
+*/
+void CN105Climate::sendNextPollRequest() {
+    if (this->pollRequestIndex >= this->pollRequestsCount) {
+        CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "poll cycle complete");
+        this->awaitedInfoType = -1;
+        this->commitSnapshot();
+        return;
     }
 
+    int packetType = this->pollRequests[this->pollRequestIndex++];
+    this->awaitedInfoType = INFOMODE[packetType];
+
+    CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "sending a request packet (%02X)", this->awaitedInfoType);
+    this->buildAndSendRequestPacket(packetType);
+    this->programResponseCheck(packetType);
+
+    // a lost reply is handled by the in-flight table (retransmission, then transactionFailed()),
+    // this only moves on if the request could not be sent at all: it may wait behind one other exchange
+    uint32_t timeout = 2 * this->replyBudgetMs(0x42, this->awaitedInfoType);
+
+    this->set_timeout(POLL_REPLY_TIMEOUT_NAME, timeout, [this]() {
+        ESP_LOGW(TAG, "no reply to request (%02X), moving on", this->awaitedInfoType);
+        this->sendNextPollRequest();
+        });
+}
+
+/**
+ * called by processDataPacket() each time a 0x62 data packet has been processed
+ * if it is the reply we were waiting for, the next request of the cycle is sent right away
+*/
+void CN105Climate::pollReplyReceived(uint8_t infoType) {
+    if (this->awaitedInfoType == infoType) {
+        this->cancel_timeout(POLL_REPLY_TIMEOUT_NAME);
+        this->sendNextPollRequest();
+    }
+}
+
+void CN105Climate::cancelPollCycle() {
+    this->cancel_timeout(POLL_REPLY_TIMEOUT_NAME);
+    this->txQueue.removePriority(TX_PRIORITY_POLL);
+    this->pollRequestIndex = this->pollRequestsCount;
+    this->awaitedInfoType = -1;
+    this->commitSnapshot();
+}
+
+
+
+
+void CN105Climate::createInfoPacket(uint8_t* packet, uint8_t packetType) {
+    CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "creating Info packet");
+
     // set the mode - settings or room temperature
+    uint8_t infoType;
     if (packetType != PACKET_TYPE_DEFAULT) {
-        packet[5] = INFOMODE[packetType];
+        infoType = INFOMODE[packetType];
     } else {
         // request current infoMode, and increment for the next request
-        packet[5] = INFOMODE[infoMode];
+        infoType = INFOMODE[infoMode];
         if (infoMode == (INFOMODE_LEN - 1)) {
             infoMode = 0;
         } else {
@@ -335,39 +480,16 @@ void CN105Climate::createInfoPacket(uint8_t* packet, uint8_t packetType) {
         }
     }
 
-    // pad the packet out
-    for (int i = 0; i < 15; i++) {
-        packet[i + 6] = 0x00;
-    }
-
-    // add the checksum
-    uint8_t chkSum = checkSum(packet, 21);
-    packet[21] = chkSum;
+    encodeInfoRequest(packet, PACKET_LEN, infoType);
 }
 void CN105Climate::set_remote_temperature(float setting) {
     uint8_t packet[PACKET_LEN] = {};
 
-    prepareSetPacket(packet, PACKET_LEN);
-
-    packet[5] = 0x07;
-    if (setting > 0) {
-        packet[6] = 0x01;
-        setting = setting * 2;
-        setting = round(setting);
-        setting = setting / 2;
-        float temp1 = 3 + ((setting - 10) * 2);
-        packet[7] = (int)temp1;
-        float temp2 = (setting * 2) + 128;
-        packet[8] = (int)temp2;
-    } else {
-        packet[6] = 0x00;
-        packet[8] = 0x80; //MHK1 send 80, even though it could be 00, since ControlByte is 00
-    }
-    // add the checksum
-    uint8_t chkSum = checkSum(packet, 21);
-    packet[21] = chkSum;
-    ESP_LOGD(TAG, "sending remote temperature packet...");
-    writePacket(packet, PACKET_LEN);
-    // optimistic
-    this->currentStatus.roomTemperature = setting;
-}
\ No newline at end of file
+    this->remoteTemperatureActive = setting > 0;
+    encodeRemoteTemperaturePacket(packet, PACKET_LEN, setting);
+
+    CN105_LOGD(LOG_SUBSYSTEM_WRITER, TAG, "sending remote temperature packet...");
+    writePacket(packet, PACKET_LEN, TX_PRIORITY_REMOTE_TEMP);
+    // optimistic, with the value the heatpump received
+    this->currentStatus.setRoomTemperature(roundf(setting * 2) / 2);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Latency distribution kept in fixed buckets, so that recording is a few comparisons and the
+ * RAM used does not depend on the number of samples
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * The percentiles are interpolated inside their bucket: their precision is the width of the
+ * bucket, which is enough to tell a 100 ms reply from a 2 s one. The max is exact.
+*/
+
+#define LATENCY_BUCKETS 17      // the last one has no upper bound
+
+static const uint32_t LATENCY_BUCKET_BOUNDS_MS[LATENCY_BUCKETS - 1] = {
+    25, 50, 100, 150, 200, 300, 400, 500, 750, 1000, 1500, 2000, 3000, 5000, 10000, 30000
+};
+
+class latencyHistogram {
+public:
+    latencyHistogram() {
+        clear();
+    }
+
+    void clear() {
+        memset(buckets, 0, sizeof(buckets));
+        count = 0;
+        max = 0;
+    }
+
+    void record(uint32_t latencyMs) {
+        size_t bucket = 0;
+        while (bucket < LATENCY_BUCKETS - 1 && latencyMs > LATENCY_BUCKET_BOUNDS_MS[bucket]) {
+            bucket++;
+        }
+        buckets[bucket]++;
+        count++;
+        max = latencyMs > max ? latencyMs : max;
+    }
+
+    // latency below which percent % of the samples are, 0 without sample
+    uint32_t percentileMs(uint8_t percent) const {
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t rank = ((uint64_t)count * percent + 99) / 100;
+        rank = rank == 0 ? 1 : rank;
+        uint64_t below = 0;
+        for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            if (below + buckets[bucket] < rank) {
+                below += buckets[bucket];
+                continue;
+            }
+            if (bucket == LATENCY_BUCKETS - 1) {
+                return max;
+            }
+            uint32_t low = bucket == 0 ? 0 : LATENCY_BUCKET_BOUNDS_MS[bucket - 1];
+            uint32_t high = LATENCY_BUCKET_BOUNDS_MS[bucket];
+            uint32_t value = low + (uint32_t)((uint64_t)(high - low) * (rank - below) / buckets[bucket]);
+            return value < max ? value : max;
+        }
+        return max;
+    }
+
+    uint32_t maxMs() const {
+        return max;
+    }
+
+    uint32_t samples() const {
+        return count;
+    }
+
+    /**
+     * writes "count p50 p95 max" then the non empty buckets as "<=bound:count" in output
+     * returns the length of the string, truncated to size - 1
+    */
+    size_t format(char* output, size_t size) const {
+        if (size == 0) {
+            return 0;
+        }
+        int length = snprintf(output, size, "n=%lu p50=%lu p95=%lu max=%lu ms |", (unsigned long)count,
+            (unsigned long)percentileMs(50), (unsigned long)percentileMs(95), (unsigned long)max);
+        for (size_t bucket = 0; bucket < LATENCY_BUCKETS && length > 0 && (size_t)length < size; bucket++) {
+            if (buckets[bucket] == 0) {
+                continue;
+            }
+            if (bucket == LATENCY_BUCKETS - 1) {
+                length += snprintf(output + length, size - length, " >%lu:%lu",
+                    (unsigned long)LATENCY_BUCKET_BOUNDS_MS[bucket - 1], (unsigned long)buckets[bucket]);
+            } else {
+                length += snprintf(output + length, size - length, " <=%lu:%lu",
+                    (unsigned long)LATENCY_BUCKET_BOUNDS_MS[bucket], (unsigned long)buckets[bucket]);
+            }
+        }
+        return length < 0 ? 0 : ((size_t)length < size ? (size_t)length : size - 1);
+    }
+
+private:
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * In-RAM trace of the frames exchanged with the heatpump
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host
+ * (tools/trace_replay.cpp decodes the dumps).
+ *
+ * Each entry is stored as:
+ *  - the time elapsed since the previous entry in microseconds, as a base 128 varint (1 to 5 bytes)
+ *  - 1 byte: bit 7 is the direction (PACKET_TRACE_TX), bits 0-6 the frame length
+ *  - the frame bytes
+ * so a 22 bytes frame costs 24 or 25 bytes. The oldest entries are dropped when the buffer is full.
+ *
+ * The dump is text, each line starts with PACKET_TRACE_MARKER so it can be extracted from a log:
+ *   CN105TRACE 1 <base time in us> <entries>
+ *   CN105TRACE+ <hex bytes of the entries, oldest first>
+ *   CN105TRACE END
+ * base time is the timestamp the first delta is relative to.
+*/
+
+#ifndef PACKET_TRACE_SIZE
+#define PACKET_TRACE_SIZE 1024      // bytes, can be changed with a build flag
+#endif
+
+#define PACKET_TRACE_TX 0x80
+#define PACKET_TRACE_LENGTH_MASK 0x7F
+#define PACKET_TRACE_VERSION 1
+#define PACKET_TRACE_MARKER "CN105TRACE"
+#define PACKET_TRACE_BYTES_PER_LINE 48
+
+class packetTrace {
+public:
+    packetTrace() {
+        clear();
+    }
+
+    void clear() {
+        head = 0;
+        used = 0;
+        entries = 0;
+        hasEntries = false;
+        baseUs = 0;
+        lastUs = 0;
+    }
+
+    void record(uint32_t nowUs, bool tx, const uint8_t* bytes, uint8_t length) {
+        if (length > PACKET_TRACE_LENGTH_MASK) {
+            length = PACKET_TRACE_LENGTH_MASK;
+        }
+
+        if (!hasEntries) {
+            baseUs = nowUs;
+            lastUs = nowUs;
+            hasEntries = true;
+        }
+        uint32_t delta = nowUs - lastUs;
+        lastUs = nowUs;
+
+        uint8_t header[6];
+        size_t headerLength = encodeVarint(delta, header);
+        header[headerLength++] = (tx ? PACKET_TRACE_TX : 0) | length;
+
+        size_t needed = headerLength + length;
+        if (needed > PACKET_TRACE_SIZE) {
+            return;
+        }
+        while (PACKET_TRACE_SIZE - used < needed) {
+            dropOldest();
+        }
+
+        for (size_t i = 0; i < headerLength; i++) {
+            push(header[i]);
+        }
+        for (size_t i = 0; i < length; i++) {
+            push(bytes[i]);
+        }
+        entries++;
+    }
+
+    size_t size() const {
+        return entries;
+    }
+
+    size_t bytesUsed() const {
+        return used;
+    }
+
+    /**
+     * calls writeLine(line) for each line of the dump, line is only valid during the call
+    */
+    template<typename F>
+    void dump(F writeLine) const {
+        char line[sizeof(PACKET_TRACE_MARKER) + 2 + PACKET_TRACE_BYTES_PER_LINE * 2 + 1];
+        static const char HEX[] = "0123456789ABCDEF";
+
+        snprintf(line, sizeof(line), PACKET_TRACE_MARKER " %d %lu %lu", PACKET_TRACE_VERSION, (unsigned long)baseUs, (unsigned long)entries);
+        writeLine(line);
+
+        size_t prefix = snprintf(line, sizeof(line), PACKET_TRACE_MARKER "+ ");
+        size_t pos = prefix;
+        for (size_t i = 0; i < used; i++) {
+            uint8_t b = buffer[(tail() + i) % PACKET_TRACE_SIZE];
+            line[pos++] = HEX[b >> 4];
+            line[pos++] = HEX[b & 0x0F];
+            if (pos - prefix == PACKET_TRACE_BYTES_PER_LINE * 2 || i == used - 1) {
+                line[pos] = '\0';
+                writeLine(line);
+                pos = prefix;
+            }
+        }
+
+        snprintf(line, sizeof(line), PACKET_TRACE_MARKER " END");
+        writeLine(line);
+    }
+
+    static size_t encodeVarint(uint32_t value, uint8_t* out) {
+        size_t n = 0;
+        while (value >= 0x80) {
+            out[n++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        out[n++] = value;
+        return n;
+    }
+
+private:
+    size_t tail() const {
+        return (head + PACKET_TRACE_SIZE - used) % PACKET_TRACE_SIZE;
+    }
+
+    void push(uint8_t b) {
+        buffer[head] = b;
+        head = (head + 1) % PACKET_TRACE_SIZE;
+        used++;
+    }
+
+    uint8_t pop() {
+        uint8_t b = buffer[tail()];
+        used--;
+        return b;
+    }
+
+    // the next entry becomes the oldest one: its delta is now relative to the dropped entry
+    void dropOldest() {
+        uint32_t delta = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            b = pop();
+            delta |= (uint32_t)(b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        baseUs += delta;
+
+        uint8_t length = pop() & PACKET_TRACE_LENGTH_MASK;
+        used -= length;
+        entries--;
+    }
+
+    uint8_t buffer[PACKET_TRACE_SIZE];
+    size_t head;            // next byte written
+    size_t used;
+    size_t entries;
+    bool hasEntries;
+    uint32_t baseUs;        // time of the entry before the oldest one
+    uint32_t lastUs;        // time of the newest entry
+};
@@ -0,0 +1,304 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <strings.h>
+
+/**
+ * Description of the CN105 protocol fields and of their byte <-> value encodings
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * Each encoding is described once, as a list of {byte, name, value} entries. The lookup tables
+ * used by the decoder (byte -> entry) and by the encoder (entry -> byte, value -> entry) are
+ * generated from it at compile time, and the description is checked for duplicates by the compiler.
+*/
+
+struct protocolEntry {
+    uint8_t byte = 0;
+    const char* name = nullptr;     // value shown to the user, nullptr for numeric fields
+    int16_t value = 0;              // numeric value (°C...), 0 for named fields
+};
+
+/**
+ * Non templated view on a protocolTable, with O(1) lookups
+ * byte -> index and value -> index return -1 when the byte or the value is unknown
+*/
+struct protocolMap {
+    const protocolEntry* entries;
+    uint8_t count;
+    const int8_t* byteIndex;
+    uint8_t byteRange;
+    const int8_t* valueIndex;
+    int16_t valueMin;
+    uint8_t valueRange;
+
+    constexpr int size() const { return count; }
+    constexpr uint8_t byteAt(int index) const { return entries[index].byte; }
+    constexpr const char* nameAt(int index) const { return entries[index].name; }
+    constexpr int valueAt(int index) const { return entries[index].value; }
+
+    constexpr int indexOfByte(uint8_t b) const {
+        return b < byteRange ? byteIndex[b] : -1;
+    }
+
+    constexpr int indexOfValue(int v) const {
+        return (v >= valueMin && v < valueMin + valueRange) ? valueIndex[v - valueMin] : -1;
+    }
+
+    // names only come from the user interface, tables are small enough for a linear search
+    int indexOfName(const char* name) const {
+        if (name == nullptr) {
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            if (entries[i].name != nullptr && strcasecmp(entries[i].name, name) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+};
+
+template <size_t N, uint8_t BYTE_RANGE, int16_t VALUE_MIN, uint8_t VALUE_RANGE>
+class protocolTable {
+public:
+    constexpr explicit protocolTable(const protocolEntry(&description)[N]) : entries{}, byteIndex{}, valueIndex{} {
+        for (size_t i = 0; i < BYTE_RANGE; i++) {
+            byteIndex[i] = -1;
+        }
+        for (size_t i = 0; i < VALUE_RANGE; i++) {
+            valueIndex[i] = -1;
+        }
+        for (size_t i = 0; i < N; i++) {
+            entries[i] = description[i];
+            byteIndex[description[i].byte] = (int8_t)i;
+            if (description[i].name == nullptr) {
+                valueIndex[description[i].value - VALUE_MIN] = (int8_t)i;
+            }
+        }
+    }
+
+    constexpr operator protocolMap() const {
+        return protocolMap{ entries, (uint8_t)N, byteIndex, BYTE_RANGE, valueIndex, VALUE_MIN, VALUE_RANGE };
+    }
+
+    constexpr int size() const { return N; }
+    constexpr uint8_t byteAt(int index) const { return entries[index].byte; }
+    constexpr const char* nameAt(int index) const { return entries[index].name; }
+    constexpr int valueAt(int index) const { return entries[index].value; }
+    constexpr int indexOfByte(uint8_t b) const { return b < BYTE_RANGE ? byteIndex[b] : -1; }
+    constexpr int indexOfValue(int v) const { return (v >= VALUE_MIN && v < VALUE_MIN + VALUE_RANGE) ? valueIndex[v - VALUE_MIN] : -1; }
+    int indexOfName(const char* name) const { return protocolMap(*this).indexOfName(name); }
+
+private:
+    protocolEntry entries[N];
+    int8_t byteIndex[BYTE_RANGE];
+    int8_t valueIndex[VALUE_RANGE > 0 ? VALUE_RANGE : 1];
+};
+
+namespace protocolCheck {
+    constexpr char lower(char c) {
+        return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+    }
+
+    constexpr bool sameName(const char* a, const char* b) {
+        while (*a != '\0' && lower(*a) == lower(*b)) {
+            a++;
+            b++;
+        }
+        return lower(*a) == lower(*b);
+    }
+
+    template <size_t N>
+    constexpr bool isValid(const protocolEntry(&d)[N]) {
+        for (size_t i = 0; i < N; i++) {
+            bool named = d[0].name != nullptr;
+            if ((d[i].name != nullptr) != named) {
+                return false;                   // a field is either named or numeric
+            }
+            for (size_t j = i + 1; j < N; j++) {
+                if (d[i].byte == d[j].byte) {
+                    return false;
+                }
+                if (named ? sameName(d[i].name, d[j].name) : d[i].value == d[j].value) {
+                    return false;
+                }
+            }
+        }
+        return N > 0 && N < 128;
+    }
+
+    template <size_t N>
+    constexpr uint8_t byteRange(const protocolEntry(&d)[N]) {
+        uint8_t max = 0;
+        for (size_t i = 0; i < N; i++) {
+            max = d[i].byte > max ? d[i].byte : max;
+        }
+        return (uint8_t)(max + 1);
+    }
+
+    template <size_t N>
+    constexpr int16_t valueMin(const protocolEntry(&d)[N]) {
+        int16_t min = d[0].value;
+        for (size_t i = 0; i < N; i++) {
+            min = d[i].value < min ? d[i].value : min;
+        }
+        return d[0].name == nullptr ? min : 0;
+    }
+
+    template <size_t N>
+    constexpr int valueRange(const protocolEntry(&d)[N]) {
+        int16_t max = d[0].value;
+        for (size_t i = 0; i < N; i++) {
+            max = d[i].value > max ? d[i].value : max;
+        }
+        return d[0].name == nullptr ? max - valueMin(d) + 1 : 0;
+    }
+}
+
+template <const auto& DESCRIPTION>
+constexpr auto makeProtocolTable() {
+    static_assert(protocolCheck::isValid(DESCRIPTION), "protocol description has duplicated or mixed entries");
+    static_assert(protocolCheck::valueRange(DESCRIPTION) < 256, "protocol values range is too large");
+    return protocolTable<sizeof(DESCRIPTION) / sizeof(DESCRIPTION[0]),
+        protocolCheck::byteRange(DESCRIPTION),
+        protocolCheck::valueMin(DESCRIPTION),
+        (uint8_t)protocolCheck::valueRange(DESCRIPTION)>(DESCRIPTION);
+}
+
+
+// ---------------------------------------------------------------------------------------------
+// encodings
+
+inline constexpr protocolEntry POWER_DESCRIPTION[] = {
+    {0x00, "OFF"}, {0x01, "ON"}
+};
+inline constexpr protocolEntry MODE_DESCRIPTION[] = {
+    {0x01, "HEAT"}, {0x02, "DRY"}, {0x03, "COOL"}, {0x07, "FAN"}, {0x08, "AUTO"}
+};
+// legacy (tempMode false) setpoint encoding
+inline constexpr protocolEntry TEMP_DESCRIPTION[] = {
+    {0x00, nullptr, 31}, {0x01, nullptr, 30}, {0x02, nullptr, 29}, {0x03, nullptr, 28},
+    {0x04, nullptr, 27}, {0x05, nullptr, 26}, {0x06, nullptr, 25}, {0x07, nullptr, 24},
+    {0x08, nullptr, 23}, {0x09, nullptr, 22}, {0x0a, nullptr, 21}, {0x0b, nullptr, 20},
+    {0x0c, nullptr, 19}, {0x0d, nullptr, 18}, {0x0e, nullptr, 17}, {0x0f, nullptr, 16}
+};
+inline constexpr protocolEntry FAN_DESCRIPTION[] = {
+    {0x00, "AUTO"}, {0x01, "QUIET"}, {0x02, "1"}, {0x03, "2"}, {0x05, "3"}, {0x06, "4"}
+};
+inline constexpr protocolEntry VANE_DESCRIPTION[] = {
+    {0x00, "AUTO"}, {0x01, "1"}, {0x02, "2"}, {0x03, "3"}, {0x04, "4"}, {0x05, "5"}, {0x07, "SWING"}
+};
+inline constexpr protocolEntry WIDEVANE_DESCRIPTION[] = {
+    {0x01, "<<"}, {0x02, "<"}, {0x03, "|"}, {0x04, ">"}, {0x05, ">>"}, {0x08, "<>"}, {0x0c, "SWING"}
+};
+// legacy (tempMode false) room temperature encoding
+inline constexpr protocolEntry ROOM_TEMP_DESCRIPTION[] = {
+    {0x00, nullptr, 10}, {0x01, nullptr, 11}, {0x02, nullptr, 12}, {0x03, nullptr, 13},
+    {0x04, nullptr, 14}, {0x05, nullptr, 15}, {0x06, nullptr, 16}, {0x07, nullptr, 17},
+    {0x08, nullptr, 18}, {0x09, nullptr, 19}, {0x0a, nullptr, 20}, {0x0b, nullptr, 21},
+    {0x0c, nullptr, 22}, {0x0d, nullptr, 23}, {0x0e, nullptr, 24}, {0x0f, nullptr, 25},
+    {0x10, nullptr, 26}, {0x11, nullptr, 27}, {0x12, nullptr, 28}, {0x13, nullptr, 29},
+    {0x14, nullptr, 30}, {0x15, nullptr, 31}, {0x16, nullptr, 32}, {0x17, nullptr, 33},
+    {0x18, nullptr, 34}, {0x19, nullptr, 35}, {0x1a, nullptr, 36}, {0x1b, nullptr, 37},
+    {0x1c, nullptr, 38}, {0x1d, nullptr, 39}, {0x1e, nullptr, 40}, {0x1f, nullptr, 41}
+};
+inline constexpr protocolEntry TIMER_MODE_DESCRIPTION[] = {
+    {0x00, "NONE"}, {0x01, "OFF"}, {0x02, "ON"}, {0x03, "BOTH"}
+};
+
+inline constexpr auto POWER_MAP = makeProtocolTable<POWER_DESCRIPTION>();
+inline constexpr auto MODE_MAP = makeProtocolTable<MODE_DESCRIPTION>();
+inline constexpr auto TEMP_MAP = makeProtocolTable<TEMP_DESCRIPTION>();
+inline constexpr auto FAN_MAP = makeProtocolTable<FAN_DESCRIPTION>();
+inline constexpr auto VANE_MAP = makeProtocolTable<VANE_DESCRIPTION>();
+inline constexpr auto WIDEVANE_MAP = makeProtocolTable<WIDEVANE_DESCRIPTION>();
+inline constexpr auto ROOM_TEMP_MAP = makeProtocolTable<ROOM_TEMP_DESCRIPTION>();
+inline constexpr auto TIMER_MODE_MAP = makeProtocolTable<TIMER_MODE_DESCRIPTION>();
+
+// indexes of the named entries, used to store the settings without their strings
+enum hpPower : uint8_t { HP_POWER_OFF, HP_POWER_ON };
+enum hpMode : uint8_t { HP_MODE_HEAT, HP_MODE_DRY, HP_MODE_COOL, HP_MODE_FAN, HP_MODE_AUTO };
+enum hpFan : uint8_t { HP_FAN_AUTO, HP_FAN_QUIET, HP_FAN_1, HP_FAN_2, HP_FAN_3, HP_FAN_4 };
+enum hpVane : uint8_t { HP_VANE_AUTO, HP_VANE_1, HP_VANE_2, HP_VANE_3, HP_VANE_4, HP_VANE_5, HP_VANE_SWING };
+enum hpWideVane : uint8_t { HP_WIDEVANE_LEFT_LEFT, HP_WIDEVANE_LEFT, HP_WIDEVANE_CENTER, HP_WIDEVANE_RIGHT, HP_WIDEVANE_RIGHT_RIGHT, HP_WIDEVANE_SPLIT, HP_WIDEVANE_SWING };
+enum hpTimerMode : uint8_t { HP_TIMER_NONE, HP_TIMER_OFF, HP_TIMER_ON, HP_TIMER_BOTH };
+
+static_assert(protocolCheck::sameName(POWER_MAP.nameAt(HP_POWER_ON), "ON") && POWER_MAP.size() == HP_POWER_ON + 1, "hpPower does not match POWER_MAP");
+static_assert(protocolCheck::sameName(MODE_MAP.nameAt(HP_MODE_FAN), "FAN") && MODE_MAP.size() == HP_MODE_AUTO + 1, "hpMode does not match MODE_MAP");
+static_assert(protocolCheck::sameName(FAN_MAP.nameAt(HP_FAN_3), "3") && FAN_MAP.size() == HP_FAN_4 + 1, "hpFan does not match FAN_MAP");
+static_assert(protocolCheck::sameName(VANE_MAP.nameAt(HP_VANE_SWING), "SWING") && VANE_MAP.size() == HP_VANE_SWING + 1, "hpVane does not match VANE_MAP");
+static_assert(protocolCheck::sameName(WIDEVANE_MAP.nameAt(HP_WIDEVANE_CENTER), "|") && WIDEVANE_MAP.size() == HP_WIDEVANE_SWING + 1, "hpWideVane does not match WIDEVANE_MAP");
+static_assert(protocolCheck::sameName(TIMER_MODE_MAP.nameAt(HP_TIMER_BOTH), "BOTH") && TIMER_MODE_MAP.size() == HP_TIMER_BOTH + 1, "hpTimerMode does not match TIMER_MODE_MAP");
+
+static_assert(MODE_MAP.indexOfByte(0x08) == 4 && MODE_MAP.indexOfByte(0x04) == -1, "MODE_MAP decode table");
+static_assert(TEMP_MAP.byteAt(TEMP_MAP.indexOfValue(16)) == 0x0f, "TEMP_MAP encode table");
+static_assert(ROOM_TEMP_MAP.valueAt(ROOM_TEMP_MAP.indexOfByte(0x1f)) == 41, "ROOM_TEMP_MAP decode table");
+
+
+// ---------------------------------------------------------------------------------------------
+// high resolution temperatures (tempMode): (°C * 2) + 128
+
+constexpr float decodeHighResTemperature(uint8_t b) {
+    return (float)((int)b - 128) / 2;
+}
+
+constexpr uint8_t encodeHighResTemperature(float temperature) {
+    return (uint8_t)((temperature * 2) + 128);
+}
+
+static_assert(encodeHighResTemperature(decodeHighResTemperature(0xAD)) == 0xAD, "high resolution temperature codec");
+
+
+// ---------------------------------------------------------------------------------------------
+// fields layout, offsets are relative to the data bytes (frame byte 5) of the 0x62 replies
+
+// 0x02 settings
+static constexpr uint8_t SETTINGS_POWER_OFFSET = 3;
+static constexpr uint8_t SETTINGS_MODE_OFFSET = 4;            // + ISEE_FLAG when the iSee sensor is present
+static constexpr uint8_t SETTINGS_TEMP_OFFSET = 5;            // TEMP_MAP
+static constexpr uint8_t SETTINGS_FAN_OFFSET = 6;
+static constexpr uint8_t SETTINGS_VANE_OFFSET = 7;
+static constexpr uint8_t SETTINGS_WIDEVANE_OFFSET = 10;       // low nibble: WIDEVANE_MAP, high nibble: WIDEVANE_ADJ_FLAG
+static constexpr uint8_t SETTINGS_TEMP_HIGHRES_OFFSET = 11;   // 0x00 when the unit does not use tempMode
+static constexpr uint8_t ISEE_FLAG = 0x08;
+static constexpr uint8_t WIDEVANE_MASK = 0x0F;
+static constexpr uint8_t WIDEVANE_ADJ_MASK = 0xF0;
+static constexpr uint8_t WIDEVANE_ADJ_FLAG = 0x80;
+
+// 0x03 room temperature
+static constexpr uint8_t ROOMTEMP_OFFSET = 3;                 // ROOM_TEMP_MAP
+static constexpr uint8_t ROOMTEMP_HIGHRES_OFFSET = 6;         // 0x00 when the unit does not use tempMode
+
+// 0x05 timers
+static constexpr uint8_t TIMERS_MODE_OFFSET = 3;              // TIMER_MODE_MAP
+static constexpr uint8_t TIMERS_ON_SET_OFFSET = 4;            // in TIMER_INCREMENT_MINUTES
+static constexpr uint8_t TIMERS_OFF_SET_OFFSET = 5;
+static constexpr uint8_t TIMERS_ON_REMAINING_OFFSET = 6;
+static constexpr uint8_t TIMERS_OFF_REMAINING_OFFSET = 7;
+
+// 0x06 status
+static constexpr uint8_t STATUS_COMPRESSOR_OFFSET = 3;        // compressor frequency in Hz
+static constexpr uint8_t STATUS_OPERATING_OFFSET = 4;
+
+// set packet (0x41), offsets are relative to the frame
+static constexpr uint8_t SET_TYPE_OFFSET = 5;                 // 0x01 settings, 0x07 remote temperature
+static constexpr uint8_t SET_FLAGS1_OFFSET = 6;
+static constexpr uint8_t SET_FLAGS2_OFFSET = 7;
+static constexpr uint8_t SET_POWER_OFFSET = 8;
+static constexpr uint8_t SET_MODE_OFFSET = 9;
+static constexpr uint8_t SET_TEMP_OFFSET = 10;                // TEMP_MAP
+static constexpr uint8_t SET_FAN_OFFSET = 11;
+static constexpr uint8_t SET_VANE_OFFSET = 12;
+static constexpr uint8_t SET_WIDEVANE_OFFSET = 18;
+static constexpr uint8_t SET_TEMP_HIGHRES_OFFSET = 19;
+static constexpr uint8_t SET_FLAG1_POWER = 0x01;
+static constexpr uint8_t SET_FLAG1_MODE = 0x02;
+static constexpr uint8_t SET_FLAG1_TEMP = 0x04;
+static constexpr uint8_t SET_FLAG1_FAN = 0x08;
+static constexpr uint8_t SET_FLAG1_VANE = 0x10;
+static constexpr uint8_t SET_FLAG2_WIDEVANE = 0x01;
+
+// remote temperature packet (0x41 0x07), offsets are relative to the frame
+static constexpr uint8_t REMOTETEMP_FLAG_OFFSET = 6;          // 0x01 use the remote temperature, 0x00 use the internal sensor
+static constexpr uint8_t REMOTETEMP_OFFSET = 7;               // 3 + ((°C - 10) * 2)
+static constexpr uint8_t REMOTETEMP_HIGHRES_OFFSET = 8;
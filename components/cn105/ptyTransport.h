@@ -0,0 +1,102 @@
+#pragma once
+#ifdef __linux__
+#include <stdint.h>
+#include <string>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "cn105Transport.h"
+
+/**
+ * The CN105 connector seen through a Linux tty: the PTY served by tools/cn105_emulator,
+ * or a USB serial adapter wired to a real unit (it is set to 8E1 at the requested baud rate,
+ * a PTY ignores it).
+*/
+class ptyTransport : public cn105Transport {
+public:
+    explicit ptyTransport(const std::string& path) : path(path) {}
+
+    ~ptyTransport() override {
+        end();
+    }
+
+    bool begin(int baud) override {
+        end();
+        this->fd = open(this->path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (this->fd < 0) {
+            return false;
+        }
+
+        struct termios tio;
+        if (tcgetattr(this->fd, &tio) == 0) {
+            cfmakeraw(&tio);
+            tio.c_cflag |= PARENB | CLOCAL | CREAD;     // 8E1
+            tio.c_cflag &= ~(PARODD | CSTOPB);
+            speed_t speed = toSpeed(baud);
+            cfsetispeed(&tio, speed);
+            cfsetospeed(&tio, speed);
+            tcsetattr(this->fd, TCSANOW, &tio);
+        }
+        return true;
+    }
+
+    void end() override {
+        if (this->fd >= 0) {
+            close(this->fd);
+            this->fd = -1;
+        }
+    }
+
+    int available() override {
+        int n = 0;
+        if (this->fd < 0 || ioctl(this->fd, FIONREAD, &n) != 0) {
+            return 0;
+        }
+        return n;
+    }
+
+    size_t read(uint8_t* buffer, size_t length) override {
+        if (this->fd < 0) {
+            return 0;
+        }
+        ssize_t n = ::read(this->fd, buffer, length);
+        return n > 0 ? n : 0;
+    }
+
+    int availableForWrite() override {
+        int queued = 0;
+        if (this->fd < 0 || ioctl(this->fd, TIOCOUTQ, &queued) != 0) {
+            return 0;
+        }
+        return queued < PTY_TRANSPORT_WRITE_ROOM ? PTY_TRANSPORT_WRITE_ROOM - queued : 0;
+    }
+
+    size_t write(const uint8_t* bytes, size_t length) override {
+        if (this->fd < 0) {
+            return 0;
+        }
+        ssize_t n = ::write(this->fd, bytes, length);
+        return n > 0 ? n : 0;
+    }
+
+    const char* name() const override {
+        return "pty";
+    }
+
+private:
+    static const int PTY_TRANSPORT_WRITE_ROOM = 128;   // like the TX FIFO of the ESP UART
+
+    static speed_t toSpeed(int baud) {
+        switch (baud) {
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        default: return B2400;
+        }
+    }
+
+    std::string path;
+    int fd = -1;
+};
+#endif
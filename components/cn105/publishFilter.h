@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * Decides if a value read from the heatpump is worth publishing to Home Assistant
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * A value is published when it differs from the last published one by at least deadband
+ * (any difference if deadband is 0) and minIntervalMs has elapsed since the last publish.
+ * A change held back by minIntervalMs is not lost: it is still different from the last
+ * published value, so it goes out with one of the next polls.
+*/
+struct publishFilter {
+    float deadband = 0;
+    uint32_t minIntervalMs = 0;
+
+    bool accepts(float value, uint64_t nowMs) const {
+        if (!this->hasPublished) {
+            return true;
+        }
+        if (isnan(value) || isnan(this->lastValue)) {
+            return isnan(value) != isnan(this->lastValue);
+        }
+
+        float delta = fabsf(value - this->lastValue);
+        if (delta == 0 || delta < this->deadband) {
+            return false;
+        }
+        return nowMs - this->lastMs >= this->minIntervalMs;
+    }
+
+    void published(float value, uint64_t nowMs) {
+        this->lastValue = value;
+        this->lastMs = nowMs;
+        this->hasPublished = true;
+    }
+
+    void reset() {
+        this->hasPublished = false;
+    }
+
+private:
+    float lastValue = NAN;
+    uint64_t lastMs = 0;
+    bool hasPublished = false;
+};
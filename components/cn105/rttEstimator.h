@@ -0,0 +1,155 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Round trip time of the exchanges with the heatpump, from which the reply timeouts are derived
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * Same method as the TCP retransmission timer (RFC 6298): each sample updates a smoothed round
+ * trip time SRTT and its mean deviation RTTVAR, and the timeout is SRTT + max(G, 4 * RTTVAR). The
+ * timeout doubles each time it elapses and stays so until the next sample, and a retransmitted
+ * request gives no sample, as its reply could answer any of the copies (Karn): so a unit slower
+ * than the initial timeout still gets measured.
+ *
+ * The round trip goes from the moment the last byte of the request has left the UART to the
+ * moment the reply frame is complete: the time the request spends on the wire at 2400 bauds is
+ * not heatpump latency, and it is added to the timeout by the caller.
+ *
+ * A settings reply does not take the same time to build as an ACK, so there is one estimate
+ * per kind of request (command and data type); a kind without sample yet uses the estimate of
+ * all the exchanges.
+*/
+
+#define RTT_INITIAL_TIMEOUT_MS 500      // before the first sample
+#define RTT_MIN_TIMEOUT_MS     100
+#define RTT_MAX_TIMEOUT_MS     4000
+#define RTT_GRANULARITY_US     100000   // G, lower bound of the 4 * RTTVAR term: on a steady link RTTVAR goes
+                                        // to 0, a reply a few tens of ms late must not be retransmitted
+#define RTT_KINDS              12       // kinds of request with their own estimate
+#define RTT_MAX_BACKOFFS       6
+
+class rttEstimator {
+public:
+    void sample(uint32_t rttUs) {
+        if (count == 0) {
+            srtt = rttUs;
+            rttvar = rttUs / 2;
+        } else {
+            int64_t delta = (int64_t)rttUs - (int64_t)srtt;
+            int64_t deviation = delta < 0 ? -delta : delta;
+            rttvar = (uint32_t)((int64_t)rttvar + (deviation - (int64_t)rttvar) / 4);      // beta = 1/4
+            srtt = (uint32_t)((int64_t)srtt + delta / 8);                                   // alpha = 1/8
+        }
+        count++;
+        backoffs = 0;
+    }
+
+    // a reply did not come in time
+    void backoff() {
+        if (backoffs < RTT_MAX_BACKOFFS) {
+            backoffs++;
+        }
+    }
+
+    uint32_t timeoutMs() const {
+        return backedOffMs(backoffs);
+    }
+
+    // time a request can stay without reply: its transmission and maxRetries retransmissions
+    uint32_t budgetMs(uint8_t maxRetries) const {
+        uint32_t budget = 0;
+        for (uint8_t retries = 0; retries <= maxRetries; retries++) {
+            budget += backedOffMs(backoffs + retries);
+        }
+        return budget;
+    }
+
+    uint32_t srttUs() const {
+        return srtt;
+    }
+    uint32_t rttvarUs() const {
+        return rttvar;
+    }
+    uint32_t samples() const {
+        return count;
+    }
+
+private:
+    uint32_t backedOffMs(uint8_t shift) const {
+        uint64_t timeout = RTT_INITIAL_TIMEOUT_MS;
+        if (count > 0) {
+            uint64_t variation = 4 * (uint64_t)rttvar;
+            variation = variation > RTT_GRANULARITY_US ? variation : RTT_GRANULARITY_US;
+            timeout = ((uint64_t)srtt + variation + 999) / 1000;
+        }
+        timeout = timeout < RTT_MIN_TIMEOUT_MS ? RTT_MIN_TIMEOUT_MS : timeout;
+        timeout <<= (shift < 16 ? shift : 16);
+        return timeout > RTT_MAX_TIMEOUT_MS ? RTT_MAX_TIMEOUT_MS : (uint32_t)timeout;
+    }
+
+    uint32_t srtt = 0;
+    uint32_t rttvar = 0;
+    uint32_t count = 0;
+    uint8_t backoffs = 0;
+};
+
+/**
+ * the estimates by kind of request, without allocation: when RTT_KINDS kinds are known, the
+ * next ones only feed the overall estimate
+*/
+class rttTable {
+public:
+    void sample(uint8_t command, uint8_t type, uint32_t rttUs) {
+        all.sample(rttUs);
+        int index = find(command, type);
+        if (index == -1 && count < RTT_KINDS) {
+            index = count++;
+            kinds[index].command = command;
+            kinds[index].type = type;
+            kinds[index].estimator = rttEstimator();
+        }
+        if (index != -1) {
+            kinds[index].estimator.sample(rttUs);
+        }
+    }
+
+    // the overall estimate backs off too, it is the one of the kinds without sample yet
+    void timedOut(uint8_t command, uint8_t type) {
+        all.backoff();
+        int index = find(command, type);
+        if (index != -1) {
+            kinds[index].estimator.backoff();
+        }
+    }
+
+    // the estimate of this kind of request if it has samples, the overall one otherwise
+    const rttEstimator& of(uint8_t command, uint8_t type) const {
+        int index = find(command, type);
+        return index != -1 ? kinds[index].estimator : all;
+    }
+
+    const rttEstimator& overall() const {
+        return all;
+    }
+
+private:
+    struct kind {
+        uint8_t command;
+        uint8_t type;
+        rttEstimator estimator;
+    };
+
+    int find(uint8_t command, uint8_t type) const {
+        for (size_t i = 0; i < count; i++) {
+            if (kinds[i].command == command && kinds[i].type == type) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    rttEstimator all;
+    kind kinds[RTT_KINDS];
+    size_t count = 0;
+};
@@ -0,0 +1,98 @@
+#include "cn105.h"
+
+/**
+ * Publication of the heatpump state to Home Assistant
+ * The polls return the same values most of the time: they are only published when they changed,
+ * see publishFilter.h for the deadband and minimum interval of the measured values.
+*/
+
+void CN105Climate::set_current_temperature_publish_filter(float deadband, uint32_t min_interval_ms) {
+    this->currentTemperatureFilter.deadband = deadband;
+    this->currentTemperatureFilter.minIntervalMs = min_interval_ms;
+}
+
+void CN105Climate::set_compressor_frequency_publish_filter(float deadband, uint32_t min_interval_ms) {
+    this->compressorFrequencyFilter.deadband = deadband;
+    this->compressorFrequencyFilter.minIntervalMs = min_interval_ms;
+}
+
+uint32_t CN105Climate::get_suppressed_publishes() const {
+    return this->health[HEALTH_SUPPRESSED_PUBLISHES];
+}
+
+/**
+ * publishes the climate entity once per committed snapshot if one of its settings changed (mode, action, target, fan, swing)
+ * or if the room temperature passes its filter
+*/
+void CN105Climate::publishClimateState() {
+    if (this->publishHeld) {
+        // a snapshot is being applied, it will be published once at the end
+        this->publishPending = true;
+        return;
+    }
+    this->publishPending = false;
+    uint64_t now = this->clock->nowMs();
+
+    if (this->commandApplied) {
+        // published now, or already published if nothing changed
+        this->latencies[LATENCY_COMMAND_PUBLISH].record((uint32_t)(now - this->commandStartedMs));
+        this->commandApplied = false;
+        this->commandStartedMs = 0;
+    }
+
+    bool settingsChanged = !this->climateStatePublished ||
+        (this->mode != this->publishedMode) ||
+        (this->action != this->publishedAction) ||
+        (this->fan_mode != this->publishedFanMode) ||
+        (this->swing_mode != this->publishedSwingMode) ||
+        !((this->target_temperature == this->publishedTargetTemperature) ||
+            (isnan(this->target_temperature) && isnan(this->publishedTargetTemperature)));
+
+    if (!settingsChanged && !this->currentTemperatureFilter.accepts(this->current_temperature, now)) {
+        this->health[HEALTH_SUPPRESSED_PUBLISHES]++;
+        ESP_LOGV(TAG, "climate state unchanged, not published (%" PRIu32 " suppressed)", this->health[HEALTH_SUPPRESSED_PUBLISHES]);
+        return;
+    }
+
+    this->publish_state();
+
+    this->climateStatePublished = true;
+    this->publishedMode = this->mode;
+    this->publishedAction = this->action;
+    this->publishedFanMode = this->fan_mode;
+    this->publishedSwingMode = this->swing_mode;
+    this->publishedTargetTemperature = this->target_temperature;
+    this->currentTemperatureFilter.published(this->current_temperature, now);
+}
+
+void CN105Climate::publishCompressorFrequency(uint8_t frequency) {
+    uint64_t now = this->clock->nowMs();
+
+    if (!this->compressorFrequencyFilter.accepts(frequency, now)) {
+        this->health[HEALTH_SUPPRESSED_PUBLISHES]++;
+        return;
+    }
+
+    this->compressor_frequency_sensor->publish_state(frequency);
+    this->compressorFrequencyFilter.published(frequency, now);
+}
+
+void CN105Climate::publishLatencySensors() {
+    for (int kind = 0; kind < LATENCY_KIND_COUNT; kind++) {
+        const latencyHistogram& histogram = this->latencies[kind];
+        if (this->latency_sensors[kind][0] == nullptr || histogram.samples() == 0) {
+            continue;
+        }
+        this->latency_sensors[kind][0]->publish_state(histogram.percentileMs(50));
+        this->latency_sensors[kind][1]->publish_state(histogram.percentileMs(95));
+        this->latency_sensors[kind][2]->publish_state(histogram.maxMs());
+    }
+}
+
+void CN105Climate::publishHealthSensors() {
+    for (int counter = 0; counter < HEALTH_COUNTER_COUNT; counter++) {
+        if (this->health_sensors[counter] != nullptr) {
+            this->health_sensors[counter]->publish_state(this->health[counter]);
+        }
+    }
+}
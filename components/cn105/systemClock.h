@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include "cn105Clock.h"
+
+#ifdef ESP32
+#include <esp_timer.h>
+#endif
+
+/**
+ * The clock of the ESP, extended to 64 bits
+ * ESP32 and ESP8266 have a 64 bits microsecond counter; elsewhere millis() and micros() are
+ * widened, which works as long as the component reads the clock from loop()
+*/
+class systemClock : public cn105Clock {
+public:
+    uint64_t nowMs() override {
+#if defined(ESP32) || defined(ESP8266)
+        return this->nowUs() / 1000;
+#else
+        return this->ms.extend(::millis());
+#endif
+    }
+
+    uint64_t nowUs() override {
+#ifdef ESP32
+        return (uint64_t)esp_timer_get_time();
+#elif defined(ESP8266)
+        return micros64();
+#else
+        return this->us.extend(::micros());
+#endif
+    }
+
+private:
+    wrapExtender ms;
+    wrapExtender us;
+};
@@ -0,0 +1,281 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include "cn105Transport.h"
+
+/**
+ * The CN105 connector reached through a serial-over-network bridge (ser2net, esp-link...
+ * or tools/cn105_emulator --listen): the bridge must be configured for 2400 bauds 8E1,
+ * the bytes are forwarded as they are.
+ *
+ * On the ESP it uses WiFiClient, on a Linux host a POSIX socket. begin() only starts the
+ * connection, availableForWrite() drives it from loop() and is 0 while it is opening: an
+ * unreachable bridge must not hold loop() for the seconds of a TCP connect timeout. When the
+ * connection fails or the bridge goes away, availableForWrite() is -1 and the reconnection of
+ * the component calls begin() again.
+*/
+
+#ifndef TCP_TRANSPORT_CONNECT_TIMEOUT_MS
+#define TCP_TRANSPORT_CONNECT_TIMEOUT_MS 250   // a bridge on the local network accepts within a few ms
+#endif
+
+enum tcpTransportState : uint8_t {
+    TCP_TRANSPORT_CLOSED,
+    TCP_TRANSPORT_RESOLVING,
+    TCP_TRANSPORT_CONNECTING,
+    TCP_TRANSPORT_CONNECTED,
+    TCP_TRANSPORT_FAILED
+};
+
+#if defined(ARDUINO) && !defined(__linux__)
+#ifdef ESP32
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+#include <WiFiClient.h>
+
+/**
+ * WiFiClient has no asynchronous connect: each step (name resolution, then the connect with a
+ * TCP_TRANSPORT_CONNECT_TIMEOUT_MS timeout) is done by its own availableForWrite() call, so loop()
+ * is held at most that long. A bridge given by its IP address needs no resolution.
+*/
+class tcpTransport : public cn105Transport {
+public:
+    tcpTransport(const std::string& host, uint16_t port) : host(host), port(port) {}
+
+    bool begin(int /*baud*/) override {
+        this->client.stop();
+        this->state = this->resolved ? TCP_TRANSPORT_CONNECTING : TCP_TRANSPORT_RESOLVING;
+        return true;
+    }
+
+    void end() override {
+        this->client.stop();
+        this->state = TCP_TRANSPORT_CLOSED;
+    }
+
+    int available() override {
+        return this->state == TCP_TRANSPORT_CONNECTED && this->client.connected() ? this->client.available() : 0;
+    }
+
+    size_t read(uint8_t* buffer, size_t length) override {
+        if (this->state != TCP_TRANSPORT_CONNECTED) {
+            return 0;
+        }
+        int n = this->client.read(buffer, length);
+        return n > 0 ? n : 0;
+    }
+
+    int availableForWrite() override {
+        switch (this->state) {
+        case TCP_TRANSPORT_RESOLVING:
+            if (this->address.fromString(this->host.c_str()) || this->resolve()) {
+                this->resolved = true;
+                this->state = TCP_TRANSPORT_CONNECTING;
+            } else {
+                this->state = TCP_TRANSPORT_FAILED;
+            }
+            return 0;
+        case TCP_TRANSPORT_CONNECTING:
+            if (this->connect()) {
+                this->client.setNoDelay(true);      // a frame must not wait for the next one
+                this->state = TCP_TRANSPORT_CONNECTED;
+            } else {
+                this->resolved = false;             // the bridge may have another address now
+                this->state = TCP_TRANSPORT_FAILED;
+            }
+            return 0;
+        case TCP_TRANSPORT_CONNECTED:
+            if (!this->client.connected()) {
+                this->state = TCP_TRANSPORT_FAILED;
+                return -1;
+            }
+            // WiFiClient buffers a whole frame, its availableForWrite() is not implemented on every core
+            return TCP_TRANSPORT_WRITE_ROOM;
+        default:
+            return -1;
+        }
+    }
+
+    size_t write(const uint8_t* bytes, size_t length) override {
+        return this->state == TCP_TRANSPORT_CONNECTED ? this->client.write(bytes, length) : 0;
+    }
+
+    const char* name() const override {
+        return "tcp";
+    }
+
+private:
+    static const int TCP_TRANSPORT_WRITE_ROOM = 64;
+
+    bool resolve() {
+#ifdef ESP32
+        return WiFi.hostByName(this->host.c_str(), this->address) == 1;
+#else
+        return WiFi.hostByName(this->host.c_str(), this->address, TCP_TRANSPORT_CONNECT_TIMEOUT_MS) == 1;
+#endif
+    }
+
+    bool connect() {
+#ifdef ESP32
+        return this->client.connect(this->address, this->port, TCP_TRANSPORT_CONNECT_TIMEOUT_MS) == 1;
+#else
+        this->client.setTimeout(TCP_TRANSPORT_CONNECT_TIMEOUT_MS);
+        return this->client.connect(this->address, this->port) == 1;
+#endif
+    }
+
+    WiFiClient client;
+    std::string host;
+    uint16_t port;
+    IPAddress address;
+    bool resolved = false;
+    tcpTransportState state = TCP_TRANSPORT_CLOSED;
+};
+
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+/**
+ * the socket is non-blocking from the start: connect() returns at once and availableForWrite()
+ * polls it until it is writable (connected) or in error, at most TCP_TRANSPORT_CONNECT_TIMEOUT_MS
+*/
+class tcpTransport : public cn105Transport {
+public:
+    tcpTransport(const std::string& host, uint16_t port) : host(host), port(port) {}
+
+    ~tcpTransport() override {
+        end();
+    }
+
+    // the name is resolved here, from the resolver of the host
+    bool begin(int /*baud*/) override {
+        end();
+
+        struct addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* addresses = nullptr;
+        std::string service = std::to_string(this->port);
+        if (getaddrinfo(this->host.c_str(), service.c_str(), &hints, &addresses) != 0) {
+            return false;
+        }
+        for (struct addrinfo* a = addresses; a != nullptr && this->fd < 0; a = a->ai_next) {
+            this->fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (this->fd < 0) {
+                continue;
+            }
+            fcntl(this->fd, F_SETFL, fcntl(this->fd, F_GETFL) | O_NONBLOCK);
+            if (connect(this->fd, a->ai_addr, a->ai_addrlen) == 0) {
+                this->connected();
+            } else if (errno == EINPROGRESS) {
+                this->state = TCP_TRANSPORT_CONNECTING;
+                this->connectStartMs = nowMs();
+            } else {
+                close(this->fd);
+                this->fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        return this->fd >= 0;
+    }
+
+    void end() override {
+        if (this->fd >= 0) {
+            close(this->fd);
+            this->fd = -1;
+        }
+        this->state = TCP_TRANSPORT_CLOSED;
+    }
+
+    int available() override {
+        int n = 0;
+        if (this->state != TCP_TRANSPORT_CONNECTED || ioctl(this->fd, FIONREAD, &n) != 0) {
+            return 0;
+        }
+        return n;
+    }
+
+    size_t read(uint8_t* buffer, size_t length) override {
+        if (this->state != TCP_TRANSPORT_CONNECTED) {
+            return 0;
+        }
+        ssize_t n = recv(this->fd, buffer, length, MSG_DONTWAIT);
+        return n > 0 ? n : 0;
+    }
+
+    int availableForWrite() override {
+        if (this->state == TCP_TRANSPORT_CONNECTING) {
+            this->pollConnect();
+        }
+        switch (this->state) {
+        case TCP_TRANSPORT_CONNECTING:
+            return 0;
+        case TCP_TRANSPORT_CONNECTED:
+            return TCP_TRANSPORT_WRITE_ROOM;
+        default:
+            return -1;
+        }
+    }
+
+    size_t write(const uint8_t* bytes, size_t length) override {
+        if (this->state != TCP_TRANSPORT_CONNECTED) {
+            return 0;
+        }
+        ssize_t n = send(this->fd, bytes, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+        return n > 0 ? n : 0;
+    }
+
+    const char* name() const override {
+        return "tcp";
+    }
+
+private:
+    static const int TCP_TRANSPORT_WRITE_ROOM = 64;
+
+    static uint64_t nowMs() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    }
+
+    void connected() {
+        int yes = 1;
+        setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        this->state = TCP_TRANSPORT_CONNECTED;
+    }
+
+    void pollConnect() {
+        struct pollfd writable = {};
+        writable.fd = this->fd;
+        writable.events = POLLOUT;
+        if (poll(&writable, 1, 0) > 0) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(this->fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+                this->connected();
+            } else {
+                this->state = TCP_TRANSPORT_FAILED;
+            }
+        } else if (nowMs() - this->connectStartMs >= TCP_TRANSPORT_CONNECT_TIMEOUT_MS) {
+            this->state = TCP_TRANSPORT_FAILED;
+        }
+    }
+
+    std::string host;
+    uint16_t port;
+    int fd = -1;
+    tcpTransportState state = TCP_TRANSPORT_CLOSED;
+    uint64_t connectStartMs = 0;
+};
+#endif
@@ -0,0 +1,357 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Transmit side of the CN105 protocol
+ * This file does not depend on esphome nor on Arduino so it can be compiled on any host.
+ *
+ * The heatpump handles one exchange at a time: a request, then its reply. The frames to send
+ * are queued here and released one by one, the most urgent first, once the previous exchange
+ * is over.
+ *
+ * A sent frame becomes a transaction of the in-flight table until the reply matching it
+ * arrives (0x7A for 0x5A, 0x61 for 0x41, 0x62 of the same data type for 0x42). Without a reply
+ * within its timeout, only that frame is sent again, up to TX_MAX_RETRIES times; then the
+ * transaction has failed and the component decides what to do. The timeouts are given by the
+ * component, from its round trip estimates (rttEstimator.h).
+*/
+
+#define TX_QUEUE_SIZE      8        // frames waiting to be sent
+#define TX_FRAME_MAX_LEN   22       // set and info packets are the largest ones we send
+#define TX_MAX_RETRIES     2        // retransmissions of a request whose reply was lost
+#define TX_IN_FLIGHT_MAX   1        // transactions waiting for their reply, the heatpump handles one at a time
+
+/**
+ * lower value is sent first
+*/
+enum txPriority : uint8_t {
+    TX_PRIORITY_CONNECT = 0,        // nothing else can be sent before the connection is established
+    TX_PRIORITY_SET,                // user commands (settings)
+    TX_PRIORITY_REMOTE_TEMP,
+    TX_PRIORITY_FUNCTIONS,          // function reads and writes
+    TX_PRIORITY_POLL,               // info requests of the poll cycle
+    TX_PRIORITY_COUNT
+};
+
+struct txFrame {
+    uint8_t bytes[TX_FRAME_MAX_LEN];
+    uint8_t length;
+    txPriority priority;
+    bool checkIsActive;             // the connection must be active to send it (false for the connect packet)
+    uint32_t sequence;              // FIFO order inside a priority
+    uint8_t retries;                // times it has already been sent without reply
+    uint64_t firstSentMs;           // first transmission, the retransmissions keep it
+};
+
+/**
+ * a frame which has been sent and waits for its reply
+*/
+struct txTransaction {
+    txFrame frame;
+    uint64_t sentMs;
+    uint64_t txDoneUs;              // when its last byte has left the UART, the round trip starts there
+    uint32_t timeoutMs;
+    bool abandoned;                 // the reply no longer matters: not retransmitted (e.g. poll cycle cancelled)
+
+    uint8_t command() const {
+        return frame.bytes[1];
+    }
+    uint8_t type() const {
+        return frame.bytes[5];
+    }
+};
+
+struct txQueueStats {
+    uint32_t sent;
+    uint32_t replaced;              // queued frames superseded by a newer one of the same kind
+    uint32_t evicted;               // lower priority frames dropped to make room
+    uint32_t dropped;               // frames refused because the queue was full of more urgent ones
+    uint32_t replyTimeouts;         // sent frames which got no reply in time
+    uint32_t retransmits;
+    uint32_t failed;                // transactions which got no reply after all the retries
+    uint32_t unmatchedReplies;      // replies to no pending request, e.g. arriving after the retries
+};
+
+/**
+ * Bounded priority queue backed by a fixed pool of frame buffers: frames are copied in, so the
+ * caller's buffer can go out of scope, and nothing is allocated on the heap.
+ *
+ * A frame of the same kind (same command and same type byte) still waiting in the queue is
+ * replaced by the new one: only the latest settings, remote temperature or request is sent.
+ * When the pool is full, the newest frame of the lowest priority is evicted if it is less urgent
+ * than the new one.
+*/
+class txFrameQueue {
+public:
+    txFrameQueue() {
+        clear();
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    void clear() {
+        for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+            used[i] = false;
+        }
+        count = 0;
+        inFlight = 0;
+    }
+
+    bool push(const uint8_t* bytes, uint8_t length, txPriority priority, bool checkIsActive = true) {
+        if (length > TX_FRAME_MAX_LEN) {
+            return false;
+        }
+
+        int slot = findSameKind(bytes, length);
+        if (slot != -1) {
+            stats.replaced++;
+        } else {
+            slot = freeSlot();
+        }
+        if (slot == -1) {
+            slot = lessUrgentThan(priority);
+            if (slot == -1) {
+                stats.dropped++;
+                return false;
+            }
+            stats.evicted++;
+            used[slot] = false;
+            count--;
+        }
+
+        txFrame& frame = frames[slot];
+        memcpy(frame.bytes, bytes, length);
+        frame.length = length;
+        frame.priority = priority;
+        frame.checkIsActive = checkIsActive;
+        frame.sequence = nextSequence++;
+        frame.retries = 0;
+        if (!used[slot]) {
+            used[slot] = true;
+            count++;
+        }
+        return true;
+    }
+
+    // the most urgent frame, nullptr if the queue is empty
+    const txFrame* peek() const {
+        int best = -1;
+        for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+            if (used[i] && (best == -1 || isBefore(frames[i], frames[best]))) {
+                best = i;
+            }
+        }
+        return best == -1 ? nullptr : &frames[best];
+    }
+
+    // removes the frame returned by peek() once it has been written and opens its transaction
+    void sent(const txFrame* frame, uint64_t nowMs, uint32_t timeoutMs, uint64_t txDoneUs) {
+        int slot = frame - frames;
+        if (inFlight < TX_IN_FLIGHT_MAX) {
+            txTransaction& transaction = transactions[inFlight++];
+            transaction.frame = *frame;
+            if (frame->retries == 0) {
+                transaction.frame.firstSentMs = nowMs;
+            }
+            transaction.sentMs = nowMs;
+            transaction.txDoneUs = txDoneUs;
+            transaction.timeoutMs = timeoutMs;
+            transaction.abandoned = false;
+        }
+        used[slot] = false;
+        count--;
+        stats.sent++;
+    }
+
+    /**
+     * a frame has been received from the heatpump: closes the oldest transaction it answers
+     * returns false if it answers none, matched is filled otherwise
+    */
+    bool replyReceived(const uint8_t* bytes, uint8_t length, txTransaction& matched) {
+        for (size_t i = 0; i < inFlight; i++) {
+            if (isReplyTo(bytes, length, transactions[i])) {
+                matched = transactions[i];
+                removeTransaction(i);
+                return true;
+            }
+        }
+        stats.unmatchedReplies++;
+        return false;
+    }
+
+    /**
+     * closes the transactions whose timeout has elapsed, onTimeout(const txTransaction&) is called
+     * for each of them: the frame is queued again, ahead of the frames of its priority, unless its
+     * retries are exhausted or a newer frame of the same kind is already queued;
+     * onFailed(const txTransaction&) is called for the failed ones
+    */
+    template<typename T, typename F>
+    void expire(uint64_t nowMs, T onTimeout, F onFailed) {
+        for (size_t i = 0; i < inFlight; ) {
+            txTransaction transaction = transactions[i];
+            if (nowMs - transaction.sentMs < transaction.timeoutMs) {
+                i++;
+                continue;
+            }
+            removeTransaction(i);
+            stats.replyTimeouts++;
+            onTimeout(transaction);
+
+            if (transaction.abandoned) {
+                continue;
+            }
+            if (findSameKind(transaction.frame.bytes, transaction.frame.length) != -1) {
+                continue;       // superseded, the newer frame will be sent instead
+            }
+            if (transaction.frame.retries < TX_MAX_RETRIES && retransmit(transaction.frame)) {
+                stats.retransmits++;
+                continue;
+            }
+            stats.failed++;
+            onFailed(transaction);
+        }
+    }
+
+    // true when a frame can be sent: the in-flight table has room
+    bool ready() const {
+        return inFlight < TX_IN_FLIGHT_MAX;
+    }
+
+    // earliest timeout of the in-flight transactions, UINT64_MAX if there is none
+    uint64_t nextExpiryMs() const {
+        uint64_t next = UINT64_MAX;
+        for (size_t i = 0; i < inFlight; i++) {
+            uint64_t expiry = transactions[i].sentMs + transactions[i].timeoutMs;
+            next = expiry < next ? expiry : next;
+        }
+        return next;
+    }
+
+    // forgets the in-flight transactions, e.g. when the link is opened again
+    void abandonInFlight() {
+        inFlight = 0;
+    }
+
+    size_t inFlightCount() const {
+        return inFlight;
+    }
+
+    // drops the queued frames of a priority, e.g. the poll requests when the poll cycle is cancelled
+    // the in-flight ones still wait for their reply but are not sent again
+    void removePriority(txPriority priority) {
+        for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+            if (used[i] && frames[i].priority == priority) {
+                used[i] = false;
+                count--;
+            }
+        }
+        for (size_t i = 0; i < inFlight; i++) {
+            if (transactions[i].frame.priority == priority) {
+                transactions[i].abandoned = true;
+            }
+        }
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    const txQueueStats& getStats() const {
+        return stats;
+    }
+
+private:
+    static bool isBefore(const txFrame& a, const txFrame& b) {
+        if (a.priority != b.priority) {
+            return a.priority < b.priority;
+        }
+        if ((a.retries != 0) != (b.retries != 0)) {
+            return a.retries != 0;      // a retransmission goes first
+        }
+        return (int32_t)(a.sequence - b.sequence) < 0;
+    }
+
+    static bool isReplyTo(const uint8_t* bytes, uint8_t length, const txTransaction& transaction) {
+        if (length < 2) {
+            return false;
+        }
+        switch (bytes[1]) {
+        case 0x7A:
+            return transaction.command() == 0x5A;
+        case 0x61:
+            return transaction.command() == 0x41;
+        case 0x62:
+            return transaction.command() == 0x42 && length > 5 && transaction.type() == bytes[5];
+        default:
+            return false;
+        }
+    }
+
+    void removeTransaction(size_t index) {
+        for (size_t i = index; i + 1 < inFlight; i++) {
+            transactions[i] = transactions[i + 1];
+        }
+        inFlight--;
+    }
+
+    bool retransmit(const txFrame& frame) {
+        int slot = freeSlot();
+        if (slot == -1) {
+            slot = lessUrgentThan(frame.priority);
+            if (slot == -1) {
+                return false;
+            }
+            stats.evicted++;
+            used[slot] = false;
+            count--;
+        }
+        frames[slot] = frame;
+        frames[slot].retries++;
+        used[slot] = true;
+        count++;
+        return true;
+    }
+
+    // command (byte 1) and type (byte 5) identify what a frame does
+    int findSameKind(const uint8_t* bytes, uint8_t length) const {
+        if (length < 6) {
+            return -1;
+        }
+        for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+            if (used[i] && frames[i].length == length &&
+                frames[i].bytes[1] == bytes[1] && frames[i].bytes[5] == bytes[5]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int freeSlot() const {
+        for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+            if (!used[i]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // the last frame that would be sent, if it is less urgent than priority
+    int lessUrgentThan(txPriority priority) const {
+        int worst = -1;
+        for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+            if (used[i] && (worst == -1 || isBefore(frames[worst], frames[i]))) {
+                worst = i;
+            }
+        }
+        return (worst != -1 && frames[worst].priority > priority) ? worst : -1;
+    }
+
+    txFrame frames[TX_QUEUE_SIZE];
+    bool used[TX_QUEUE_SIZE];
+    size_t count;
+    uint32_t nextSequence = 0;
+    txTransaction transactions[TX_IN_FLIGHT_MAX];
+    size_t inFlight;
+    txQueueStats stats;
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include <Arduino.h>
+#include "cn105Transport.h"
+
+/**
+ * The CN105 connector wired to a hardware UART of the ESP
+*/
+class uartTransport : public cn105Transport {
+public:
+    explicit uartTransport(HardwareSerial* serial) : serial(serial) {}
+
+    // -1 keeps the default pins of the UART
+    void setPins(int txPin, int rxPin) {
+        this->txPin = txPin;
+        this->rxPin = rxPin;
+    }
+
+    bool begin(int baud) override {
+        if (this->serial == nullptr) {
+            return false;
+        }
+        if (this->txPin != -1 && this->rxPin != -1) {
+#ifdef ESP8266
+            this->serial->begin(baud, SERIAL_8E1);
+            this->serial->pins(this->txPin, this->rxPin);
+#elif defined(ESP32)
+            this->serial->begin(baud, SERIAL_8E1, this->rxPin, this->txPin);
+#else
+            this->serial->begin(baud, SERIAL_8E1);
+#endif
+        } else {
+            this->serial->begin(baud, SERIAL_8E1);
+        }
+        return true;
+    }
+
+    void end() override {
+        if (this->serial != nullptr) {
+            this->serial->end();
+        }
+    }
+
+    int available() override {
+        return this->serial->available();
+    }
+
+    size_t read(uint8_t* buffer, size_t length) override {
+        return this->serial->read(buffer, length);
+    }
+
+    int availableForWrite() override {
+        return this->serial->availableForWrite();
+    }
+
+    size_t write(const uint8_t* bytes, size_t length) override {
+        return this->serial->write(bytes, length);
+    }
+
+    const char* name() const override {
+        return "uart";
+    }
+
+    HardwareSerial* getSerial() const {
+        return this->serial;
+    }
+
+private:
+    HardwareSerial* serial;
+    int txPin = -1;
+    int rxPin = -1;
+};
@@ -3,38 +3,6 @@
 
 
 
-bool CN105Climate::hasChanged(const char* before, const char* now, const char* field, bool checkNotNull) {
-    if (now == NULL) {
-        if (checkNotNull) {
-            ESP_LOGE(TAG, "CAUTION: expected value in hasChanged() function for %s, got NULL", field);
-        } else {
-            ESP_LOGD(TAG, "No value in hasChanged() function for %s", field);
-        }
-        return false;
-    }
-    return ((before == NULL) || (strcmp(before, now) != 0));
-}
-
-
-
-bool CN105Climate::isWantedSettingApplied(const char* wantedSettingProp, const char* currentSettingProp, const char* field) {
-
-    bool isEqual = ((wantedSettingProp == NULL) || (strcmp(wantedSettingProp, currentSettingProp) == 0));
-
-    if (!isEqual) {
-        ESP_LOGD(TAG, "wanted %s is not set yet", field);
-        ESP_LOGD(TAG, "Wanted %s is not set yet, want:%s, got: %s", field, wantedSettingProp, currentSettingProp);
-    }
-
-    if (wantedSettingProp != NULL) {
-        ESP_LOGE(TAG, "CAUTION: expected value in hasChanged() function for %s, got NULL", field);
-        ESP_LOGD(TAG, "No value in hasChanged() function for %s", field);
-    }
-
-    return isEqual;
-}
-
-
 const char* getIfNotNull(const char* what, const char* defaultValue) {
     if (what == NULL) {
         return defaultValue;
@@ -42,64 +10,118 @@ const char* getIfNotNull(const char* what, const char* defaultValue) {
     return what;
 }
 
-void CN105Climate::debugSettings(const char* settingName, wantedHeatpumpSettings settings) {
-    ESP_LOGI(LOG_ACTION_EVT_TAG, "[%-*s]-> [power: %-*s, target °C: %2f, mode: %-*s, fan: %-*s, vane: %-*s, hasChanged ? -> %s]",
+void CN105Climate::set_log_level(uint8_t subsystem, uint8_t level) {
+    if (subsystem < LOG_SUBSYSTEM_COUNT) {
+        this->logLevels[subsystem] = level;
+    }
+}
+
+void CN105Climate::debugSettings(const char* settingName, const wantedHeatpumpSettings& settings) {
+    CN105_LOGI(LOG_SUBSYSTEM_SETTINGS, LOG_ACTION_EVT_TAG, "[%-*s]-> [power: %-*s, target °C: %2f, mode: %-*s, fan: %-*s, vane: %-*s, hasChanged: %s, hasBeenSent: %s, dirty: 0x%02X]",
         15, getIfNotNull(settingName, "unnamed"),
-        3, getIfNotNull(settings.power, "-"),
-        settings.temperature,
-        6, getIfNotNull(settings.mode, "-"),
-        6, getIfNotNull(settings.fan, "-"),
-        6, getIfNotNull(settings.vane, "-"),
+        3, POWER_MAP.nameAt(settings.power),
+        settings.getTemperature(),
+        6, MODE_MAP.nameAt(settings.mode),
+        6, FAN_MAP.nameAt(settings.fan),
+        6, VANE_MAP.nameAt(settings.vane),
         settings.hasChanged ? "YES" : " NO",
-        settings.hasBeenSent ? "YES" : " NO"
+        settings.hasBeenSent ? "YES" : " NO",
+        settings.dirtyFields
     );
 }
 
-void CN105Climate::debugSettings(const char* settingName, heatpumpSettings settings) {
-    ESP_LOGI(LOG_SETTINGS_TAG, "[%-*s]-> [power: %-*s, target °C: %2f, mode: %-*s, fan: %-*s, vane: %-*s]",
+void CN105Climate::debugSettings(const char* settingName, const heatpumpSettings& settings) {
+    CN105_LOGI(LOG_SUBSYSTEM_SETTINGS, LOG_SETTINGS_TAG, "[%-*s]-> [power: %-*s, target °C: %2f, mode: %-*s, fan: %-*s, vane: %-*s]",
         15, getIfNotNull(settingName, "unnamed"),
-        3, getIfNotNull(settings.power, "-"),
-        settings.temperature,
-        6, getIfNotNull(settings.mode, "-"),
-        6, getIfNotNull(settings.fan, "-"),
-        6, getIfNotNull(settings.vane, "-")
+        3, POWER_MAP.nameAt(settings.power),
+        settings.getTemperature(),
+        6, MODE_MAP.nameAt(settings.mode),
+        6, FAN_MAP.nameAt(settings.fan),
+        6, VANE_MAP.nameAt(settings.vane)
     );
 }
 
 
-void CN105Climate::debugStatus(const char* statusName, heatpumpStatus status) {
+void CN105Climate::debugStatus(const char* statusName, const heatpumpStatus& status) {
 
-    ESP_LOGI(LOG_STATUS_TAG, "[%-*s]-> [room C°: %.1f, operating: %-*s, compressor freq: %2d Hz]",
+    CN105_LOGI(LOG_SUBSYSTEM_SETTINGS, LOG_STATUS_TAG, "[%-*s]-> [room C°: %.1f, operating: %-*s, compressor freq: %2d Hz]",
         15, statusName,
-        status.roomTemperature,
+        status.getRoomTemperature(),
         3, status.operating ? "YES" : "NO ",
         status.compressorFrequency);
 
 }
 
 
-void CN105Climate::debugSettingsAndStatus(const char* settingName, heatpumpSettings settings, heatpumpStatus status) {
+void CN105Climate::debugSettingsAndStatus(const char* settingName, const heatpumpSettings& settings, const heatpumpStatus& status) {
     this->debugSettings(settingName, settings);
     this->debugStatus(settingName, status);
 }
 
 
+void CN105Climate::dump_packet_trace() {
+    ESP_LOGI(TAG, "packet trace: %u frames, %u bytes", (unsigned)this->trace.size(), (unsigned)this->trace.bytesUsed());
+    this->trace.dump([](const char* line) { ESP_LOGI("trace", "%s", line); });
+}
+
+void CN105Climate::clear_packet_trace() {
+    this->trace.clear();
+}
+
+void CN105Climate::dump_latency_histograms() {
+    char line[256];
+    for (int kind = 0; kind < LATENCY_KIND_COUNT; kind++) {
+        this->latencies[kind].format(line, sizeof(line));
+        ESP_LOGI("latency", "%s: %s", LATENCY_NAMES[kind], line);
+    }
+}
+
+void CN105Climate::clear_latency_histograms() {
+    for (int kind = 0; kind < LATENCY_KIND_COUNT; kind++) {
+        this->latencies[kind].clear();
+    }
+}
 
-void CN105Climate::hpPacketDebug(uint8_t* packet, unsigned int length, const char* packetDirection) {
-    char buffer[4]; // Petit tampon pour stocker chaque octet sous forme de texte
-    char outputBuffer[length * 4 + 1]; // Tampon pour stocker l'ensemble des octets sous forme de texte
+const latencyHistogram& CN105Climate::get_latency_histogram(latencyKind kind) const {
+    return this->latencies[kind];
+}
 
-    // Initialisation du tampon de sortie avec une chaîne vide
-    outputBuffer[0] = '\0';
+void CN105Climate::reset_health_counters() {
+    memset(this->health, 0, sizeof(this->health));
+    this->publishHealthSensors();
+}
 
-    for (unsigned int i = 0; i < length; i++) {
-        snprintf(buffer, sizeof(buffer), "%02X ", packet[i]); // Utilisation de snprintf pour éviter les dépassements de tampon
-        strcat(outputBuffer, buffer);
+uint32_t CN105Climate::get_health_counter(healthCounter counter) const {
+    return this->health[counter];
+}
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+/**
+ * formats length bytes as "FC 62 01 ..." in output, which must hold 3 * length + 1 chars
+ * returns the length of the string
+*/
+static size_t formatHex(const uint8_t* bytes, size_t length, char* output) {
+    char* p = output;
+    for (size_t i = 0; i < length; i++) {
+        *p++ = HEX_DIGITS[bytes[i] >> 4];
+        *p++ = HEX_DIGITS[bytes[i] & 0x0F];
+        *p++ = ' ';
     }
+    *p = '\0';
+    return p - output;
+}
 
-    char outputForSensor[15];
-    strncpy(outputForSensor, outputBuffer, 14);
-    outputForSensor[14] = '\0'; // Ajouter un caract
+void CN105Climate::hpPacketDebug(const uint8_t* packet, unsigned int length, const char* packetDirection, logSubsystem subsystem) {
+    if (!CN105_LOG_ENABLED(subsystem, ESPHOME_LOG_LEVEL_DEBUG)) {
+        return;
+    }
+
+    char outputBuffer[FRAME_MAX_LEN * 3 + 1];
+    if (length > FRAME_MAX_LEN) {
+        length = FRAME_MAX_LEN;
+    }
+    formatHex(packet, length, outputBuffer);
 
     /*if (strcasecmp(packetDirection, "WRITE") == 0) {
         this->last_sent_packet_sensor->publish_state(outputForSensor);
@@ -109,41 +131,22 @@ void CN105Climate::hpPacketDebug(uint8_t* packet, unsigned int length, const cha
 }
 
 
-int CN105Climate::lookupByteMapIndex(const int valuesMap[], int len, int lookupValue) {
-    for (int i = 0; i < len; i++) {
-        if (valuesMap[i] == lookupValue) {
-            return i;
-        }
+/**
+ * the lookups below are O(1) thanks to the tables generated in protocolTables.h
+ * except the lookup by name which only happens when the user changes a setting
+ * an unknown value is logged but never blocks the loop
+*/
+int CN105Climate::lookupByteMapIndex(const protocolMap& map, int lookupValue) {
+    int index = map.indexOfValue(lookupValue);
+    if (index == -1) {
+        ESP_LOGW("lookup", "Attention valeur %d non trouvée, on retourne -1", lookupValue);
     }
-    ESP_LOGW("lookup", "Attention valeur %d non trouvée, on retourne -1", lookupValue);
-    esphome::delay(200);
-    return -1;
-}
-int CN105Climate::lookupByteMapIndex(const char* valuesMap[], int len, const char* lookupValue) {
-    for (int i = 0; i < len; i++) {
-        if (strcasecmp(valuesMap[i], lookupValue) == 0) {
-            return i;
-        }
-    }
-    ESP_LOGW("lookup", "Attention valeur %s non trouvée, on retourne -1", lookupValue);
-    esphome::delay(200);
-    return -1;
-}
-const char* CN105Climate::lookupByteMapValue(const char* valuesMap[], const uint8_t byteMap[], int len, uint8_t byteValue) {
-    for (int i = 0; i < len; i++) {
-        if (byteMap[i] == byteValue) {
-            return valuesMap[i];
-        }
-    }
-    ESP_LOGW("lookup", "Attention valeur %d non trouvée, on retourne la valeur au rang 0", byteValue);
-    return valuesMap[0];
-}
-int CN105Climate::lookupByteMapValue(const int valuesMap[], const uint8_t byteMap[], int len, uint8_t byteValue) {
-    for (int i = 0; i < len; i++) {
-        if (byteMap[i] == byteValue) {
-            return valuesMap[i];
-        }
+    return index;
+}
+int CN105Climate::lookupByteMapIndex(const protocolMap& map, const char* lookupValue) {
+    int index = map.indexOfName(lookupValue);
+    if (index == -1) {
+        ESP_LOGW("lookup", "Attention valeur %s non trouvée, on retourne -1", lookupValue != NULL ? lookupValue : "NULL");
     }
-    ESP_LOGW("lookup", "Attention valeur %d non trouvée, on retourne la valeur au rang 0", byteValue);
-    return valuesMap[0];
-}
\ No newline at end of file
+    return index;
+}
@@ -0,0 +1,374 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "frameReader.h"
+#include "cn105Codec.h"
+
+/**
+ * Emulation of the indoor unit side of the CN105 connector
+ * It does not do any I/O: the bytes written by the component are given to receive(), and
+ * transmit() returns the bytes of the replies once they are due. tools/cn105_emulator.cpp
+ * serves it on a PTY or on a socket, a host test can also call it directly.
+ *
+ * Modelled:
+ *  - the connect handshake, nothing is answered before it
+ *  - 0x41 set packets (settings 0x01, remote temperature 0x07, functions 0x1F/0x21), answered by 0x61
+ *  - 0x42 info requests 0x02 0x03 0x04 0x05 0x06 0x09 0x20 0x22, answered by 0x62
+ *  - tempMode (high resolution temperatures) or the legacy encoding, and the iSee sensor
+ *  - a room that slowly goes towards the setpoint while the unit is on
+ *
+ * and the imperfections of a real link: reply delay and jitter, dropped replies, corrupted
+ * bytes, and the 2400 bauds line rate (11 bits per byte with 8E1).
+*/
+
+struct cn105EmulatorConfig {
+    uint32_t replyDelayUs = 20000;      // from the end of the request to the first byte of the reply
+    uint32_t jitterUs = 0;              // uniform, added to replyDelayUs
+    float dropRate = 0;                 // probability that a request is not answered
+    float corruptRate = 0;              // probability that one bit of a reply is flipped
+    uint32_t baudRate = 2400;           // 0: the reply is available at once
+    bool tempMode = true;               // high resolution temperatures
+    bool iSee = false;
+    uint32_t seed = 1;
+};
+
+struct cn105EmulatorStats {
+    uint32_t requests[256];             // valid frames received, by command
+    uint32_t infoRequests[256];         // 0x42 requests, by info type
+    uint32_t replies;
+    uint32_t dropped;
+    uint32_t corrupted;
+    uint32_t ignored;                   // valid frames received before the connect packet or unknown
+    uint32_t rxErrors;                  // frames rejected by the frame reader
+};
+
+class cn105Emulator {
+public:
+    explicit cn105Emulator(const cn105EmulatorConfig& config = cn105EmulatorConfig()) : config(config), random(config.seed) {
+        memset(&stats, 0, sizeof(stats));
+        settings.power = HP_POWER_OFF;
+        settings.mode = HP_MODE_HEAT;
+        settings.setTemperature(21);
+        settings.fan = HP_FAN_AUTO;
+        settings.vane = HP_VANE_AUTO;
+        settings.wideVane = HP_WIDEVANE_CENTER;
+        status.setRoomTemperature(19);
+        // functions 101 to 128, all set to 1
+        uint8_t data[15];
+        for (int i = 0; i < 15; i++) {
+            data[i] = ((i + 1) << 2) + 1;
+        }
+        functions.setData1(data);
+        for (int i = 0; i < 13; i++) {
+            data[i] = ((i + 16) << 2) + 1;
+        }
+        data[13] = 0;
+        data[14] = 0;
+        functions.setData2(data);
+    }
+
+    // bytes written by the component at nowUs, they are received once the line has carried them
+    void receive(const uint8_t* bytes, size_t length, uint64_t nowUs) {
+        simulate(nowUs);
+        uint64_t byteUs = config.baudRate > 0 ? 11000000ULL / config.baudRate : 0;
+        rxLineUs = (rxLineUs > nowUs ? rxLineUs : nowUs) + length * byteUs;
+        nowUs = rxLineUs;
+        while (length > 0) {
+            size_t n = length < reader.writable() ? length : reader.writable();
+            memcpy(reader.writePointer(), bytes, n);
+            reader.commit(n);
+            bytes += n;
+            length -= n;
+
+            cn105Frame frame;
+            while (reader.next(frame)) {
+                handle(frame, nowUs);
+            }
+        }
+        stats.rxErrors = reader.getStats().errors();
+    }
+
+    // appends to out the reply bytes due at nowUs, returns how many were appended
+    size_t transmit(uint64_t nowUs, std::vector<uint8_t>& out) {
+        simulate(nowUs);
+        size_t count = 0;
+        while (!pending.empty() && pending.front().dueUs <= nowUs) {
+            out.push_back(pending.front().byte);
+            pending.pop_front();
+            count++;
+        }
+        return count;
+    }
+
+    // time of the next byte to transmit, UINT64_MAX when there is none
+    uint64_t nextTransmitUs() const {
+        return pending.empty() ? UINT64_MAX : pending.front().dueUs;
+    }
+
+    const cn105EmulatorStats& getStats() const {
+        return stats;
+    }
+
+    const heatpumpSettings& getSettings() const {
+        return settings;
+    }
+
+    const heatpumpStatus& getStatus() const {
+        return status;
+    }
+
+    bool isConnected() const {
+        return connected;
+    }
+
+    // changes made with the IR remote
+    void setSettings(const heatpumpSettings& newSettings) {
+        settings = newSettings;
+    }
+
+    void setRoomTemperature(float temperature) {
+        roomTemperature = temperature;
+        status.setRoomTemperature(roundf(temperature * 2) / 2);
+    }
+
+private:
+    struct pendingByte {
+        uint64_t dueUs;
+        uint8_t byte;
+    };
+
+    void handle(const cn105Frame& frame, uint64_t nowUs) {
+        stats.requests[frame.command()]++;
+        const uint8_t* data = frame.data();
+
+        if (frame.command() == 0x5A) {
+            connected = true;
+            static const uint8_t CONNECT_REPLY[] = { 0xfc, 0x7a, 0x01, 0x30, 0x01, 0x00, 0x54 };
+            reply(CONNECT_REPLY, sizeof(CONNECT_REPLY), nowUs);
+            return;
+        }
+        if (!connected || frame.dataLength() < 1) {
+            stats.ignored++;
+            return;
+        }
+
+        uint8_t out[PACKET_LEN];
+        switch (frame.command()) {
+        case 0x41:
+            if (!applySet(frame.bytes)) {
+                stats.ignored++;
+                return;
+            }
+            beginReply(out, 0x61);
+            break;
+        case 0x42:
+            stats.infoRequests[data[0]]++;
+            beginReply(out, 0x62);
+            out[FRAME_HEADER_LEN] = data[0];
+            if (!fillInfo(data[0], out + FRAME_HEADER_LEN)) {
+                stats.ignored++;
+                return;
+            }
+            break;
+        default:
+            stats.ignored++;
+            return;
+        }
+        out[PACKET_LEN - 1] = cn105Checksum(out, PACKET_LEN - 1);
+        reply(out, PACKET_LEN, nowUs);
+    }
+
+    static void beginReply(uint8_t* out, uint8_t command) {
+        memset(out, 0, PACKET_LEN);
+        out[0] = FRAME_START_BYTE;
+        out[1] = command;
+        out[2] = FRAME_HEADER_BYTE2;
+        out[3] = FRAME_HEADER_BYTE3;
+        out[4] = PACKET_LEN - FRAME_HEADER_LEN - 1;
+    }
+
+    bool applySet(const uint8_t* packet) {
+        switch (packet[SET_TYPE_OFFSET]) {
+        case SET_TYPE_SETTINGS: {
+            uint8_t flags = packet[SET_FLAGS1_OFFSET];
+            int index;
+            if ((flags & SET_FLAG1_POWER) && (index = POWER_MAP.indexOfByte(packet[SET_POWER_OFFSET])) != -1) {
+                settings.power = (hpPower)index;
+            }
+            if ((flags & SET_FLAG1_MODE) && (index = MODE_MAP.indexOfByte(packet[SET_MODE_OFFSET])) != -1) {
+                settings.mode = (hpMode)index;
+            }
+            if (flags & SET_FLAG1_TEMP) {
+                if (packet[SET_TEMP_HIGHRES_OFFSET] != 0) {
+                    settings.setTemperature(decodeHighResTemperature(packet[SET_TEMP_HIGHRES_OFFSET]));
+                } else if ((index = TEMP_MAP.indexOfByte(packet[SET_TEMP_OFFSET])) != -1) {
+                    settings.setTemperature(TEMP_MAP.valueAt(index));
+                }
+            }
+            if ((flags & SET_FLAG1_FAN) && (index = FAN_MAP.indexOfByte(packet[SET_FAN_OFFSET])) != -1) {
+                settings.fan = (hpFan)index;
+            }
+            if ((flags & SET_FLAG1_VANE) && (index = VANE_MAP.indexOfByte(packet[SET_VANE_OFFSET])) != -1) {
+                settings.vane = (hpVane)index;
+            }
+            if (packet[SET_FLAGS2_OFFSET] & SET_FLAG2_WIDEVANE) {
+                if ((index = WIDEVANE_MAP.indexOfByte(packet[SET_WIDEVANE_OFFSET] & WIDEVANE_MASK)) != -1) {
+                    settings.wideVane = (hpWideVane)index;
+                }
+                wideVaneAdj = (packet[SET_WIDEVANE_OFFSET] & WIDEVANE_ADJ_MASK) == WIDEVANE_ADJ_FLAG;
+            }
+            return true;
+        }
+        case SET_TYPE_REMOTE_TEMP:
+            remoteTemperature = packet[REMOTETEMP_FLAG_OFFSET] == 0x01;
+            if (remoteTemperature) {
+                status.roomTemperatureCode = packet[REMOTETEMP_HIGHRES_OFFSET];
+            }
+            return true;
+        case FUNCTIONS_SET_PART1:
+            functions.setData1(&packet[6]);
+            return true;
+        case FUNCTIONS_SET_PART2:
+            functions.setData2(&packet[6]);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // data[0] is already the info type
+    bool fillInfo(uint8_t infoType, uint8_t* data) {
+        switch (infoType) {
+        case 0x02: {
+            data[SETTINGS_POWER_OFFSET] = POWER_MAP.byteAt(settings.power);
+            data[SETTINGS_MODE_OFFSET] = MODE_MAP.byteAt(settings.mode) + (config.iSee ? ISEE_FLAG : 0);
+            int index = TEMP_MAP.indexOfValue((int)settings.getTemperature());
+            data[SETTINGS_TEMP_OFFSET] = TEMP_MAP.byteAt(index > -1 ? index : 0);
+            data[SETTINGS_FAN_OFFSET] = FAN_MAP.byteAt(settings.fan);
+            data[SETTINGS_VANE_OFFSET] = VANE_MAP.byteAt(settings.vane);
+            data[SETTINGS_WIDEVANE_OFFSET] = WIDEVANE_MAP.byteAt(settings.wideVane) | (wideVaneAdj ? WIDEVANE_ADJ_FLAG : 0);
+            data[SETTINGS_TEMP_HIGHRES_OFFSET] = config.tempMode ? encodeHighResTemperature(settings.getTemperature()) : 0x00;
+            return true;
+        }
+        case 0x03: {
+            float room = status.getRoomTemperature();
+            int index = ROOM_TEMP_MAP.indexOfValue((int)room);
+            data[ROOMTEMP_OFFSET] = ROOM_TEMP_MAP.byteAt(index > -1 ? index : 0);
+            data[ROOMTEMP_HIGHRES_OFFSET] = config.tempMode ? status.roomTemperatureCode : 0x00;
+            return true;
+        }
+        case 0x04:
+            return true;
+        case 0x05:
+            data[TIMERS_MODE_OFFSET] = TIMER_MODE_MAP.byteAt(status.timers.mode);
+            data[TIMERS_ON_SET_OFFSET] = status.timers.onMinutesSet;
+            data[TIMERS_OFF_SET_OFFSET] = status.timers.offMinutesSet;
+            data[TIMERS_ON_REMAINING_OFFSET] = status.timers.onMinutesRemaining;
+            data[TIMERS_OFF_REMAINING_OFFSET] = status.timers.offMinutesRemaining;
+            return true;
+        case 0x06:
+            data[STATUS_COMPRESSOR_OFFSET] = status.compressorFrequency;
+            data[STATUS_OPERATING_OFFSET] = status.operating;
+            return true;
+        case 0x09:
+            data[3] = settings.power == HP_POWER_ON ? 0x00 : 0x01;
+            data[4] = settings.power == HP_POWER_ON ? 0x01 : 0x00;
+            return true;
+        case FUNCTIONS_GET_PART1:
+            functions.getData1(&data[1]);
+            return true;
+        case FUNCTIONS_GET_PART2:
+            functions.getData2(&data[1]);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // queues a reply, with the delay, the loss and the corruption of the link
+    void reply(const uint8_t* bytes, size_t length, uint64_t nowUs) {
+        if (chance(config.dropRate)) {
+            stats.dropped++;
+            return;
+        }
+
+        uint8_t copy[FRAME_MAX_LEN];
+        memcpy(copy, bytes, length);
+        if (chance(config.corruptRate)) {
+            std::uniform_int_distribution<size_t> position(0, length * 8 - 1);
+            size_t bit = position(random);
+            copy[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+            stats.corrupted++;
+        }
+
+        uint64_t dueUs = nowUs + config.replyDelayUs;
+        if (config.jitterUs > 0) {
+            dueUs += std::uniform_int_distribution<uint32_t>(0, config.jitterUs)(random);
+        }
+        // a reply starts after the end of the previous one
+        if (!pending.empty() && pending.back().dueUs > dueUs) {
+            dueUs = pending.back().dueUs;
+        }
+        uint64_t byteUs = config.baudRate > 0 ? 11000000ULL / config.baudRate : 0;
+        for (size_t i = 0; i < length; i++) {
+            dueUs += byteUs;
+            pending.push_back({ dueUs, copy[i] });
+        }
+        stats.replies++;
+    }
+
+    bool chance(float rate) {
+        return rate > 0 && std::uniform_real_distribution<float>(0, 1)(random) < rate;
+    }
+
+    /**
+     * once per second: the room goes towards the setpoint at 0.1 °C/s when the unit is on,
+     * the compressor frequency follows the remaining difference
+    */
+    void simulate(uint64_t nowUs) {
+        if (lastSimulationUs == 0) {
+            lastSimulationUs = nowUs;
+            return;
+        }
+        while (nowUs - lastSimulationUs >= 1000000) {
+            lastSimulationUs += 1000000;
+
+            float target = settings.getTemperature();
+            bool heating = settings.mode == HP_MODE_HEAT || (settings.mode == HP_MODE_AUTO && roomTemperature < target);
+            bool cooling = settings.mode == HP_MODE_COOL || settings.mode == HP_MODE_DRY || (settings.mode == HP_MODE_AUTO && roomTemperature > target);
+            float difference = target - roomTemperature;
+
+            bool working = settings.power == HP_POWER_ON && ((heating && difference > 0) || (cooling && difference < 0));
+            if (working) {
+                roomTemperature += difference > 0 ? 0.1f : -0.1f;
+            }
+            status.operating = working;
+            status.compressorFrequency = working ? (uint8_t)fminf(20 + fabsf(difference) * 15, 100) : 0;
+            if (!remoteTemperature) {
+                status.setRoomTemperature(roundf(roomTemperature * 2) / 2);
+            }
+        }
+    }
+
+    cn105EmulatorConfig config;
+    std::mt19937 random;
+    frameReader reader;
+    std::deque<pendingByte> pending;
+    cn105EmulatorStats stats;
+
+    bool connected = false;
+    heatpumpSettings settings;
+    heatpumpStatus status;
+    heatpumpFunctions functions;
+    bool wideVaneAdj = false;
+    bool remoteTemperature = false;
+    float roomTemperature = 19;
+    uint64_t lastSimulationUs = 0;
+    uint64_t rxLineUs = 0;              // when the last byte received from the component has been carried
+};
@@ -0,0 +1,220 @@
+/**
+ * Emulates the indoor unit side of the CN105 connector on a Linux host (see cn105Emulator.h)
+ *
+ * build (from the repository root):
+ *   g++ -std=c++17 -O2 -Icomponents/cn105 -Itools tools/cn105_emulator.cpp -o cn105_emulator
+ * usage:
+ *   ./cn105_emulator [options]              serves a new PTY, its path is printed
+ *   ./cn105_emulator --link /tmp/cn105 ...  and makes /tmp/cn105 a link to it
+ *   ./cn105_emulator --listen 8105 ...      serves one TCP client at a time (serial bridge)
+ *   ./cn105_emulator --fd 3 ...             serves an inherited descriptor (socketpair)
+ * options:
+ *   --delay-ms N     delay before a reply (default 20)
+ *   --jitter-ms N    random delay added to each reply (default 0)
+ *   --drop P         probability that a request is not answered (0 to 1)
+ *   --corrupt P      probability that one bit of a reply is flipped (0 to 1)
+ *   --baud N         line rate of the replies, 0 for none (default 2400)
+ *   --legacy-temp    the unit does not use tempMode
+ *   --isee           the unit has an iSee sensor
+ *   --seed N         seed of the random generator
+ *   -v               prints each frame
+ * The counters are printed when the emulator is stopped (Ctrl-C).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "cn105Emulator.h"
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+    stopping = 1;
+}
+
+static uint64_t nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void printFrame(const char* direction, const uint8_t* bytes, size_t length, uint64_t timeUs) {
+    printf("%12.3f ms %s ", timeUs / 1000.0, direction);
+    for (size_t i = 0; i < length; i++) {
+        printf("%02X ", bytes[i]);
+    }
+    printf("\n");
+}
+
+static int openPty(const char* link) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    const char* slave = ptsname(master);
+
+    // the slave is kept open: the master would report EIO each time the component closes it
+    int slaveFd = open(slave, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slaveFd >= 0 && tcgetattr(slaveFd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(slaveFd, TCSANOW, &tio);
+    }
+
+    if (link != nullptr) {
+        unlink(link);
+        if (symlink(slave, link) != 0) {
+            perror(link);
+        }
+    }
+    printf("emulator listening on %s%s%s\n", slave, link != nullptr ? " -> " : "", link != nullptr ? link : "");
+    return master;
+}
+
+static int openListener(int port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1) != 0) {
+        perror("listen");
+        return -1;
+    }
+    printf("emulator listening on tcp port %d\n", port);
+    return listener;
+}
+
+static void printStats(const cn105Emulator& emulator) {
+    const cn105EmulatorStats& stats = emulator.getStats();
+    printf("requests: connect %u, set %u, info %u (", stats.requests[0x5A], stats.requests[0x41], stats.requests[0x42]);
+    for (int i = 0; i < 256; i++) {
+        if (stats.infoRequests[i] != 0) {
+            printf(" %02X:%u", i, stats.infoRequests[i]);
+        }
+    }
+    printf(" )\nreplies %u, dropped %u, corrupted %u, ignored %u, rx errors %u\n",
+        stats.replies, stats.dropped, stats.corrupted, stats.ignored, stats.rxErrors);
+
+    const heatpumpSettings& settings = emulator.getSettings();
+    printf("state: power %s, mode %s, target %.1f, fan %s, vane %s, widevane %s, room %.1f, compressor %d Hz\n",
+        POWER_MAP.nameAt(settings.power), MODE_MAP.nameAt(settings.mode), settings.getTemperature(),
+        FAN_MAP.nameAt(settings.fan), VANE_MAP.nameAt(settings.vane), WIDEVANE_MAP.nameAt(settings.wideVane),
+        emulator.getStatus().getRoomTemperature(), emulator.getStatus().compressorFrequency);
+}
+
+int main(int argc, char** argv) {
+    cn105EmulatorConfig config;
+    const char* link = nullptr;
+    int port = -1;
+    int fd = -1;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool needsValue = strcmp(arg, "-v") != 0 && strcmp(arg, "--legacy-temp") != 0 && strcmp(arg, "--isee") != 0;
+        if (needsValue && value == nullptr) {
+            fprintf(stderr, "%s needs a value\n", arg);
+            return 1;
+        }
+
+        if (strcmp(arg, "--delay-ms") == 0) config.replyDelayUs = atoi(value) * 1000;
+        else if (strcmp(arg, "--jitter-ms") == 0) config.jitterUs = atoi(value) * 1000;
+        else if (strcmp(arg, "--drop") == 0) config.dropRate = atof(value);
+        else if (strcmp(arg, "--corrupt") == 0) config.corruptRate = atof(value);
+        else if (strcmp(arg, "--baud") == 0) config.baudRate = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) config.seed = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--link") == 0) link = value;
+        else if (strcmp(arg, "--listen") == 0) port = atoi(value);
+        else if (strcmp(arg, "--fd") == 0) fd = atoi(value);
+        else if (strcmp(arg, "--legacy-temp") == 0) config.tempMode = false;
+        else if (strcmp(arg, "--isee") == 0) config.iSee = true;
+        else if (strcmp(arg, "-v") == 0) verbose = true;
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+        if (needsValue) {
+            i++;
+        }
+    }
+
+    int listener = -1;
+    if (port > 0) {
+        listener = openListener(port);
+        if (listener < 0) return 1;
+    } else if (fd < 0) {
+        fd = openPty(link);
+        if (fd < 0) return 1;
+    }
+    fflush(stdout);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    cn105Emulator emulator(config);
+    uint64_t startUs = nowUs();
+    std::vector<uint8_t> out;
+
+    while (!stopping) {
+        if (fd < 0) {
+            fd = accept(listener, nullptr, nullptr);       // interrupted by the signals
+            if (fd < 0) continue;
+            printf("client connected\n");
+            fflush(stdout);
+        }
+
+        uint64_t now = nowUs();
+        uint64_t next = emulator.nextTransmitUs();
+        int timeoutMs = next == UINT64_MAX ? 1000 : (next <= now ? 0 : (int)((next - now + 999) / 1000));
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeoutMs);
+        now = nowUs();
+
+        if (ready > 0 && (pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+            uint8_t buffer[256];
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                if (verbose) printFrame("RX", buffer, n, now - startUs);
+                emulator.receive(buffer, n, now);
+            } else if (n == 0 || (errno != EAGAIN && errno != EINTR && errno != EIO)) {
+                if (listener < 0) break;
+                printf("client disconnected\n");
+                close(fd);
+                fd = -1;
+                continue;
+            } else if (errno == EIO) {
+                usleep(10000);              // PTY closed by the component, it will be opened again
+            }
+        }
+
+        out.clear();
+        if (emulator.transmit(now, out) > 0) {
+            if (verbose) printFrame("TX", out.data(), out.size(), now - startUs);
+            if (write(fd, out.data(), out.size()) < 0 && listener >= 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        fflush(stdout);
+    }
+
+    printStats(emulator);
+    return 0;
+}
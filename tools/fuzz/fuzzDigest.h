@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * What the fuzz targets decoded, folded into one FNV-1a hash
+ *
+ * The standalone driver (fuzz_driver.cpp --digest) prints it after running a corpus: a change
+ * of the decoders which is only meant to make them faster must give the same digest, on the
+ * same corpus, before and after. libFuzzer ignores it.
+*/
+inline uint64_t fuzzDigest = 0xcbf29ce484222325ULL;
+
+inline void digestBytes(const void* bytes, size_t length) {
+    const uint8_t* p = (const uint8_t*)bytes;
+    for (size_t i = 0; i < length; i++) {
+        fuzzDigest = (fuzzDigest ^ p[i]) * 0x100000001b3ULL;
+    }
+}
+
+template<typename T>
+inline void digestValue(const T& value) {
+    digestBytes(&value, sizeof(value));
+}
@@ -0,0 +1,271 @@
+/**
+ * Standalone driver for the fuzz targets of this directory, for compilers without libFuzzer
+ * (gcc) or to replay a corpus
+ *
+ * It calls LLVMFuzzerTestOneInput() with each file of the corpus, then with -runs=N mutations
+ * of them. It is not coverage guided: to help it reach the decoders, half of the mutated
+ * inputs get the checksum of the frames they contain repaired. Use libFuzzer (or AFL++ with
+ * its libFuzzer driver) for real coverage guided fuzzing; the targets are the same.
+ *
+ * usage:
+ *   ./fuzz_target [options] FILE|DIR...
+ *   -runs=N          mutated inputs to run after the corpus (default 0)
+ *   -seed=N          seed of the mutations (default 1)
+ *   -max_len=N       max length of a mutated input (default 512)
+ *   -artifact_prefix=P  where the input which crashed is written (default ./)
+ *   --digest         prints the digest of what was decoded (see fuzzDigest.h)
+ *
+ * When a sanitizer or a check of the target fails, the input is written to
+ * <artifact_prefix>crash-<hash>; run the driver with that file to reproduce.
+*/
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fuzzDigest.h"
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_UNDEFINED__)
+#define FUZZ_DRIVER_SANITIZER 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(undefined_behavior_sanitizer)
+#define FUZZ_DRIVER_SANITIZER 1
+#endif
+#endif
+#ifdef FUZZ_DRIVER_SANITIZER
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* bytes, size_t length);
+
+typedef std::vector<uint8_t> fuzzInput;
+
+static const fuzzInput* currentInput = nullptr;
+static std::string artifactPrefix = "./";
+
+static void saveCurrentInput() {
+    if (currentInput == nullptr) {
+        return;
+    }
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint8_t b : *currentInput) {
+        hash = (hash ^ b) * 0x100000001b3ULL;
+    }
+    char path[512];
+    snprintf(path, sizeof(path), "%scrash-%016llx", artifactPrefix.c_str(), (unsigned long long)hash);
+    FILE* f = fopen(path, "wb");
+    if (f != nullptr) {
+        fwrite(currentInput->data(), 1, currentInput->size(), f);
+        fclose(f);
+        fprintf(stderr, "fuzz_driver: input written to %s (%zu bytes)\n", path, currentInput->size());
+    }
+    currentInput = nullptr;
+}
+
+#ifdef FUZZ_DRIVER_SANITIZER
+// the reports end with abort(), caught below, whether the death callback runs or not
+extern "C" const char* __asan_default_options() {
+    return "abort_on_error=1";
+}
+extern "C" const char* __ubsan_default_options() {
+    return "abort_on_error=1:print_stacktrace=1";
+}
+#endif
+
+static void crashHandler(int signal) {
+    saveCurrentInput();
+    ::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+static bool readFile(const std::string& path, fuzzInput& input) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t n;
+    input.clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        input.insert(input.end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static void addPath(const std::string& path, std::vector<fuzzInput>& corpus) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        fprintf(stderr, "fuzz_driver: cannot read %s\n", path.c_str());
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        fuzzInput input;
+        if (readFile(path, input)) {
+            corpus.push_back(input);
+        }
+        return;
+    }
+
+    // sorted, so that --digest does not depend on the order of the directory
+    std::vector<std::string> names;
+    DIR* dir = opendir(path.c_str());
+    struct dirent* entry;
+    while (dir != nullptr && (entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    if (dir != nullptr) {
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+    for (const auto& name : names) {
+        addPath(path + "/" + name, corpus);
+    }
+}
+
+// recomputes the checksum of every frame header found in input (see cn105Checksum())
+static void repairChecksums(fuzzInput& input) {
+    for (size_t i = 0; i + 5 < input.size(); i++) {
+        if (input[i] != 0xFC) {
+            continue;
+        }
+        size_t end = i + 5 + input[i + 4];
+        if (end >= input.size()) {
+            break;
+        }
+        uint8_t sum = 0;
+        for (size_t j = i; j < end; j++) {
+            sum += input[j];
+        }
+        input[end] = (0xFC - sum) & 0xFF;
+        i = end;
+    }
+}
+
+static void mutate(fuzzInput& input, const std::vector<fuzzInput>& corpus, std::mt19937& rng, size_t maxLength) {
+    static const uint8_t TOKENS[][5] = {
+        { 0xFC, 0x62, 0x01, 0x30, 0x10 }, { 0xFC, 0x61, 0x01, 0x30, 0x10 }, { 0xFC, 0x7A, 0x01, 0x30, 0x01 },
+        { 0x02, 0x03, 0x04, 0x05, 0x06 }, { 0x09, 0x20, 0x22, 0x80, 0xFF },
+    };
+    int mutations = 1 + rng() % 4;
+    for (int m = 0; m < mutations; m++) {
+        size_t size = input.size();
+        switch (rng() % 7) {
+        case 0:     // flips a bit
+            if (size > 0) input[rng() % size] ^= 1 << (rng() % 8);
+            break;
+        case 1:     // sets a byte
+            if (size > 0) input[rng() % size] = rng();
+            break;
+        case 2:     // inserts a byte
+            input.insert(input.begin() + (size > 0 ? rng() % (size + 1) : 0), (uint8_t)rng());
+            break;
+        case 3:     // erases a range
+            if (size > 1) {
+                size_t from = rng() % size;
+                size_t count = 1 + rng() % std::min<size_t>(size - from, 8);
+                input.erase(input.begin() + from, input.begin() + from + count);
+            }
+            break;
+        case 4: {   // inserts a token
+            const uint8_t* token = TOKENS[rng() % (sizeof(TOKENS) / sizeof(TOKENS[0]))];
+            size_t at = size > 0 ? rng() % (size + 1) : 0;
+            input.insert(input.begin() + at, token, token + 5);
+            break;
+        }
+        case 5: {   // splices a part of another input
+            const fuzzInput& other = corpus[rng() % corpus.size()];
+            if (!other.empty()) {
+                size_t from = rng() % other.size();
+                size_t count = 1 + rng() % (other.size() - from);
+                size_t at = size > 0 ? rng() % (size + 1) : 0;
+                input.insert(input.begin() + at, other.begin() + from, other.begin() + from + count);
+            }
+            break;
+        }
+        default:    // duplicates a range
+            if (size > 0) {
+                size_t from = rng() % size;
+                size_t count = 1 + rng() % (size - from);
+                fuzzInput chunk(input.begin() + from, input.begin() + from + count);
+                input.insert(input.end(), chunk.begin(), chunk.end());
+            }
+            break;
+        }
+    }
+    if (input.size() > maxLength) {
+        input.resize(maxLength);
+    }
+    if (rng() % 2 == 0) {
+        repairChecksums(input);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long runs = 0;
+    unsigned long seed = 1;
+    size_t maxLength = 512;
+    bool digest = false;
+    std::vector<fuzzInput> corpus;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "-runs=", 6) == 0) runs = strtoul(arg + 6, nullptr, 10);
+        else if (strncmp(arg, "-seed=", 6) == 0) seed = strtoul(arg + 6, nullptr, 10);
+        else if (strncmp(arg, "-max_len=", 9) == 0) maxLength = strtoul(arg + 9, nullptr, 10);
+        else if (strncmp(arg, "-artifact_prefix=", 17) == 0) artifactPrefix = arg + 17;
+        else if (strcmp(arg, "--digest") == 0) digest = true;
+        else if (arg[0] == '-') {
+            fprintf(stderr, "fuzz_driver: unknown option %s\n", arg);
+            return 2;
+        } else {
+            addPath(arg, corpus);
+        }
+    }
+
+#ifdef FUZZ_DRIVER_SANITIZER
+    __sanitizer_set_death_callback(saveCurrentInput);
+#endif
+    signal(SIGILL, crashHandler);       // __builtin_trap() of the checks of the targets
+    signal(SIGABRT, crashHandler);
+    signal(SIGFPE, crashHandler);
+
+    for (const auto& input : corpus) {
+        currentInput = &input;
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    currentInput = nullptr;
+    printf("fuzz_driver: %zu corpus inputs run\n", corpus.size());
+    if (digest) {
+        printf("fuzz_driver: digest %016llx\n", (unsigned long long)fuzzDigest);
+    }
+
+    if (runs > 0) {
+        if (corpus.empty()) {
+            corpus.push_back(fuzzInput());
+        }
+        std::mt19937 rng(seed);
+        fuzzInput input;
+        for (unsigned long run = 1; run <= runs; run++) {
+            input = corpus[rng() % corpus.size()];
+            mutate(input, corpus, rng, maxLength);
+            currentInput = &input;
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+            if ((run & (run - 1)) == 0 || run == runs) {
+                printf("fuzz_driver: %lu mutated inputs run\n", run);
+                fflush(stdout);
+            }
+        }
+        currentInput = nullptr;
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * Fuzz target: arbitrary bytes received from the heatpump
+ *
+ * The input goes through the component as on the ESP: loopback transport -> processInput()
+ * -> frameReader -> processDataPacket() -> getDataFromResponsePacket(). Then every frame the
+ * frame reader accepts is also given to each decoder of cn105Codec.h, whatever its type, to
+ * check the length checks of all of them.
+ *
+ * build with libFuzzer (clang):
+ *   clang++ -std=gnu++17 -g -O1 -fsanitize=fuzzer,address,undefined -DARDUINO=100 \
+ *       -Itools/host/include -Icomponents/cn105 $(find components/cn105 -name "*.cpp") tools/host/esphome_host.cpp \
+ *       tools/fuzz/fuzz_frames.cpp -o fuzz_frames
+ *   ./fuzz_frames -dict=tools/fuzz/cn105.dict tools/fuzz/corpus/frames
+ * build with the standalone driver (gcc or clang, see fuzz_driver.cpp):
+ *   g++ -std=gnu++17 -g -O1 -fsanitize=address,undefined -fno-sanitize-recover=all -DARDUINO=100 \
+ *       -Itools/host/include -Icomponents/cn105 $(find components/cn105 -name "*.cpp") tools/host/esphome_host.cpp \
+ *       tools/fuzz/fuzz_frames.cpp tools/fuzz/fuzz_driver.cpp -o fuzz_frames
+ *   ./fuzz_frames -runs=1000000 tools/fuzz/corpus/frames
+*/
+#include "esphome.h"
+#include "esphomeHost.h"
+#include "cn105.h"
+#include "fuzzDigest.h"
+
+static loopbackTransport loopback;
+static CN105Climate* heatpump = nullptr;
+
+static void setupClimate() {
+    esphome_host::logLevel = ESPHOME_LOG_LEVEL_NONE;
+    heatpump = new CN105Climate(&Serial);
+    heatpump->set_transport(&loopback);
+    heatpump->set_baud_rate(2400);
+    heatpump->setup();
+}
+
+static void decodeAll(const cn105Frame& frame) {
+    const uint8_t* data = frame.data();
+    size_t length = frame.dataLength();
+
+    settingsReply reply{};
+    digestValue(decodeSettings(data, length, reply));
+    digestValue(reply.settings.packed());
+    digestValue(reply.highResTemperature);
+    digestValue(reply.wideVaneAdj);
+
+    heatpumpStatus status{};
+    digestValue(decodeRoomTemperature(data, length, status));
+    digestValue(decodeStatus(data, length, status));
+    heatpumpTimers timers{};
+    digestValue(decodeTimers(data, length, timers));
+    digestValue(status.packed());
+    digestValue(timers.mode);
+    digestValue(timers.onMinutesSet);
+    digestValue(timers.onMinutesRemaining);
+    digestValue(timers.offMinutesSet);
+    digestValue(timers.offMinutesRemaining);
+
+    heatpumpFunctions functions;
+    digestValue(decodeFunctions(data, length, functions));
+    uint8_t part[15];
+    functions.getData1(part);
+    digestBytes(part, sizeof(part));
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* bytes, size_t length) {
+    if (heatpump == nullptr) {
+        setupClimate();
+    }
+
+    // the component, fed in chunks like the UART would
+    size_t offset = 0;
+    uint8_t sink[LOOPBACK_TRANSPORT_SIZE];
+    while (offset < length) {
+        offset += loopback.peerWrite(bytes + offset, length - offset);
+        heatpump->loop();
+        loopback.peerRead(sink, sizeof(sink));      // what the component sends back
+        esphome_host::advanceUs(100000);
+        esphome_host::runScheduler();
+    }
+    digestValue(heatpump->mode);
+    digestValue(heatpump->target_temperature);
+    digestValue(heatpump->current_temperature);
+    digestValue(heatpump->get_compressor_frequency());
+
+    // the decoders on their own
+    frameReader reader;
+    cn105Frame frame;
+    offset = 0;
+    while (offset < length) {
+        size_t n = std::min(reader.writable(), length - offset);
+        memcpy(reader.writePointer(), bytes + offset, n);
+        reader.commit(n);
+        offset += n;
+        while (reader.next(frame)) {
+            digestBytes(frame.bytes, frame.length);
+            decodeAll(frame);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * Fuzz target: the functions table (heatpumpFunctions.h) filled with arbitrary blocks
+ *
+ * The input is two 15 bytes blocks given to setData1() / setData2(), then pairs of bytes used
+ * as (code, value) for getValue() / setValue(). The invariants checked are the ones the
+ * component relies on: a block reads back as it was written, getAllCodes() only flags the
+ * codes 101..128 as valid, and a table equals its copy.
+ *
+ * build: like fuzz_frames.cpp, without the component sources:
+ *   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -Icomponents/cn105 \
+ *       tools/fuzz/fuzz_functions.cpp -o fuzz_functions
+ *   g++ -std=c++17 -g -O1 -fsanitize=address,undefined -fno-sanitize-recover=all -Icomponents/cn105 \
+ *       tools/fuzz/fuzz_functions.cpp tools/fuzz/fuzz_driver.cpp -o fuzz_functions
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "heatpumpFunctions.h"
+#include "fuzzDigest.h"
+
+static const size_t BLOCK_LEN = 15;
+
+#define FUZZ_CHECK(condition) do { if (!(condition)) { __builtin_trap(); } } while (0)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* bytes, size_t length) {
+    if (length < 2 * BLOCK_LEN) {
+        return 0;
+    }
+    heatpumpFunctions functions;
+    functions.setData1(bytes);
+    functions.setData2(bytes + BLOCK_LEN);
+    FUZZ_CHECK(functions.isValid());
+
+    uint8_t block[BLOCK_LEN];
+    functions.getData1(block);
+    FUZZ_CHECK(memcmp(block, bytes, BLOCK_LEN) == 0);
+    functions.getData2(block);
+    FUZZ_CHECK(memcmp(block, bytes + BLOCK_LEN, BLOCK_LEN) == 0);
+
+    heatpumpFunctions copy = functions;
+    FUZZ_CHECK(copy == functions);
+
+    for (size_t i = 2 * BLOCK_LEN; i + 1 < length; i += 2) {
+        int code = 100 + bytes[i] % 32;
+        int value = bytes[i + 1] % 5;
+        bool set = functions.setValue(code, value);
+        int read = functions.getValue(code);
+        FUZZ_CHECK(!set || read == value);
+        digestValue(set);
+        digestValue(read);
+    }
+
+    heatpumpFunctionCodes codes = functions.getAllCodes();
+    for (int i = 0; i < MAX_FUNCTION_CODE_COUNT; i++) {
+        FUZZ_CHECK(codes.valid[i] == (codes.code[i] >= 101 && codes.code[i] <= 128));
+        digestValue(codes.code[i]);
+        digestValue(codes.valid[i]);
+    }
+
+    // setValue() only touches existing codes: the table differs from its copy only if a value changed
+    copy.getData1(block);
+    uint8_t changed[BLOCK_LEN];
+    functions.getData1(changed);
+    bool same = memcmp(block, changed, BLOCK_LEN) == 0;
+    copy.getData2(block);
+    functions.getData2(changed);
+    same = same && memcmp(block, changed, BLOCK_LEN) == 0;
+    FUZZ_CHECK(same == (copy == functions));
+    return 0;
+}
@@ -0,0 +1,370 @@
+/**
+ * Micro benchmarks of the hot paths of the cn105 component: frame parsing, packet building,
+ * protocol table lookups, reply decoding and the functions table
+ *
+ * build (from the repository root, see cn105_host.cpp for the host shim):
+ *   g++ -std=gnu++17 -O2 -DARDUINO=100 -Itools/host/include -Icomponents/cn105 \
+ *       $(find components/cn105 -name "*.cpp") tools/host/esphome_host.cpp tools/host/cn105_bench.cpp -o cn105_bench
+ * usage:
+ *   ./cn105_bench                                        runs everything
+ *   ./cn105_bench --filter decode                        only the benchmarks whose name contains "decode"
+ *   ./cn105_bench --baseline tools/host/bench_baseline.txt   compares, exit code 1 on a regression
+ *   ./cn105_bench --save tools/host/bench_baseline.txt   records a new baseline
+ *   ./cn105_bench --save /tmp/mine.txt, then later --baseline /tmp/mine.txt --tolerance 0.25
+ *   --min-time-ms N (default 200) time spent measuring each benchmark
+ *   --tolerance P        ns/op slowdown accepted against the baseline, ns/op are not compared without it
+ *
+ * Each benchmark reports ns/op and heap allocations per op (counted by the operator new of
+ * this program). An op allocating more than in the baseline is always a regression, on any
+ * machine. ns/op depends on the machine and the compiler: the ns/op of the committed baseline
+ * are only indicative, compare times against a baseline saved on the machine the comparison
+ * runs on.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "esphome.h"
+#include "esphomeHost.h"
+#include "cn105.h"
+
+static uint64_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+// not inlined: gcc would otherwise see the free() of a pointer from operator new and warn
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+// keeps the compiler from removing a computation whose result is not used
+template<typename T>
+static inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct benchResult {
+    std::string name;
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+static uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static const char* filter = nullptr;
+static uint64_t minTimeNs = 200000000;
+static std::vector<benchResult> results;
+
+/**
+ * runs op in batches of growing size until minTimeNs is spent in one batch
+*/
+template<typename F>
+static void bench(const char* name, F op) {
+    if (filter != nullptr && strstr(name, filter) == nullptr) {
+        return;
+    }
+
+    for (uint64_t iterations = 1; ; iterations *= 4) {
+        uint64_t allocationsBefore = allocations;
+        uint64_t start = monotonicNs();
+        for (uint64_t i = 0; i < iterations; i++) {
+            op();
+        }
+        uint64_t elapsed = monotonicNs() - start;
+
+        if (elapsed >= minTimeNs || iterations >= ((uint64_t)1 << 40)) {
+            benchResult result{ name, (double)elapsed / iterations, (double)(allocations - allocationsBefore) / iterations };
+            printf("%-36s %10.1f ns/op %8.2f allocs/op %12llu ops\n", name, result.nsPerOp, result.allocsPerOp, (unsigned long long)iterations);
+            results.push_back(result);
+            return;
+        }
+    }
+}
+
+// a 0x62 info reply as sent by the heatpump
+static std::vector<uint8_t> infoReply(uint8_t infoType, std::initializer_list<std::pair<int, uint8_t>> fields) {
+    std::vector<uint8_t> frame = { 0xFC, 0x62, 0x01, 0x30, 0x10 };
+    uint8_t data[16] = { infoType };
+    for (const auto& field : fields) {
+        data[field.first] = field.second;
+    }
+    frame.insert(frame.end(), data, data + sizeof(data));
+    frame.push_back(cn105Checksum(frame.data(), frame.size()));
+    return frame;
+}
+
+static const std::vector<uint8_t> SETTINGS_REPLY = infoReply(0x02, { {3, 0x01}, {4, 0x01}, {5, 0x07}, {6, 0x00}, {7, 0x00}, {10, 0x03}, {11, 0xB0} });
+static const std::vector<uint8_t> ROOM_TEMP_REPLY = infoReply(0x03, { {3, 0x0B}, {6, 0xAA} });
+static const std::vector<uint8_t> STATUS_REPLY = infoReply(0x06, { {3, 0x2A}, {4, 0x01} });
+static const std::vector<uint8_t> CONNECT_REPLY = { 0xFC, 0x7A, 0x01, 0x30, 0x01, 0x00, 0x54 };
+
+static void benchFrameReader() {
+    // a poll cycle as seen on the wire, with a byte of noise between two frames
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 8; i++) {
+        stream.insert(stream.end(), SETTINGS_REPLY.begin(), SETTINGS_REPLY.end());
+        stream.insert(stream.end(), ROOM_TEMP_REPLY.begin(), ROOM_TEMP_REPLY.end());
+        stream.push_back(0x00);
+        stream.insert(stream.end(), STATUS_REPLY.begin(), STATUS_REPLY.end());
+    }
+    frameReader reader;
+    cn105Frame frame;
+
+    // one op is one frame
+    bench("frameReader.next (per frame)", [&]() {
+        static size_t offset = 0;
+        while (true) {
+            if (reader.next(frame)) {
+                keep(frame.bytes[5]);
+                return;
+            }
+            size_t n = std::min(reader.writable(), stream.size() - offset);
+            memcpy(reader.writePointer(), stream.data() + offset, n);
+            reader.commit(n);
+            offset = (offset + n) % stream.size();
+        }
+    });
+}
+
+static void benchCodec() {
+    uint8_t packet[PACKET_LEN] = {};
+    bench("cn105Checksum", [&]() {
+        packet[7]++;
+        keep(cn105Checksum(packet, PACKET_LEN - 1));
+    });
+
+    wantedHeatpumpSettings settings{};
+    settings.power = HP_POWER_ON;
+    settings.mode = HP_MODE_HEAT;
+    settings.setTemperature(22.5f);
+    settings.fan = HP_FAN_AUTO;
+    settings.vane = HP_VANE_AUTO;
+    settings.wideVane = HP_WIDEVANE_CENTER;
+    // what the private createPacket() and createInfoPacket() of the component call
+    bench("encodeSettingsPacket", [&]() {
+        keep(encodeSettingsPacket(packet, PACKET_LEN, settings, SETTINGS_FIELD_ALL, true, false));
+        keep(packet);
+    });
+    bench("encodeInfoRequest", [&]() {
+        keep(encodeInfoRequest(packet, PACKET_LEN, 0x06));
+        keep(packet);
+    });
+    float temperature = 20.0f;
+    bench("encodeRemoteTemperaturePacket", [&]() {
+        temperature = temperature < 25 ? temperature + 0.1f : 20.0f;
+        keep(encodeRemoteTemperaturePacket(packet, PACKET_LEN, temperature));
+        keep(packet);
+    });
+
+    settingsReply reply{};
+    bench("decodeSettings", [&]() {
+        keep(decodeSettings(SETTINGS_REPLY.data() + 5, 16, reply));
+        keep(reply);
+    });
+    heatpumpStatus status{};
+    bench("decodeRoomTemperature", [&]() {
+        keep(decodeRoomTemperature(ROOM_TEMP_REPLY.data() + 5, 16, status));
+        keep(status);
+    });
+    bench("decodeStatus", [&]() {
+        keep(decodeStatus(STATUS_REPLY.data() + 5, 16, status));
+        keep(status);
+    });
+}
+
+static void benchProtocolTables() {
+    static const char* const FAN_NAMES[] = { "AUTO", "QUIET", "1", "2", "3", "4" };
+    int i = 0;
+    bench("protocolMap.indexOfName (FAN)", [&]() {
+        keep(FAN_MAP.indexOfName(FAN_NAMES[i++ % 6]));
+    });
+    bench("protocolMap.indexOfValue (TEMP)", [&]() {
+        keep(TEMP_MAP.indexOfValue(16 + i++ % 16));
+    });
+    bench("protocolMap.indexOfByte (ROOM_TEMP)", [&]() {
+        keep(ROOM_TEMP_MAP.indexOfByte((uint8_t)(i++ & 0x1F)));
+    });
+    bench("protocolMap.nameAt (MODE)", [&]() {
+        keep(MODE_MAP.nameAt(i++ % MODE_MAP.size()));
+    });
+}
+
+static void benchFunctions() {
+    heatpumpFunctions functions;
+    uint8_t part[15];
+    for (int j = 0; j < 15; j++) {
+        part[j] = (uint8_t)(((j + 1) << 2) + 1);            // codes 101..115, value 1
+    }
+    functions.setData1(part);
+    for (int j = 0; j < 15; j++) {
+        part[j] = j < 13 ? (uint8_t)(((j + 16) << 2) + 2) : 0;    // codes 116..128, value 2
+    }
+    functions.setData2(part);
+
+    int code = 101;
+    bench("heatpumpFunctions.getValue", [&]() {
+        keep(functions.getValue(code));
+        code = code < 128 ? code + 1 : 101;
+    });
+    bench("heatpumpFunctions.setValue", [&]() {
+        keep(functions.setValue(code, 1 + code % 3));
+        code = code < 128 ? code + 1 : 101;
+    });
+    bench("heatpumpFunctions.getAllCodes", [&]() {
+        heatpumpFunctionCodes codes = functions.getAllCodes();
+        keep(codes);
+    });
+}
+
+/**
+ * the component itself, on a loopback transport: the replies go through loop() as on the ESP
+*/
+static void benchComponent() {
+    loopbackTransport loopback;
+    CN105Climate* climate = new CN105Climate(&Serial);
+    climate->set_transport(&loopback);
+    climate->set_baud_rate(2400);
+    climate->setup();
+    loopback.peerWrite(CONNECT_REPLY.data(), CONNECT_REPLY.size());
+    climate->loop();
+
+    uint8_t sink[LOOPBACK_TRANSPORT_SIZE];
+    auto receive = [&](const std::vector<uint8_t>& frame) {
+        loopback.peerWrite(frame.data(), frame.size());
+        climate->loop();
+        keep(loopback.peerRead(sink, sizeof(sink)));      // drops what the component sends back
+    };
+
+    bench("loop: 0x02 settings reply", [&]() { receive(SETTINGS_REPLY); });
+    bench("loop: 0x03 room temperature reply", [&]() { receive(ROOM_TEMP_REPLY); });
+    bench("loop: 0x06 status reply", [&]() { receive(STATUS_REPLY); });
+
+    float temperature = 20.0f;
+    bench("set_remote_temperature", [&]() {
+        temperature = temperature < 25 ? temperature + 0.5f : 20.0f;
+        climate->set_remote_temperature(temperature);
+    });
+}
+
+static bool saveBaseline(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f == nullptr) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "# cn105_bench baseline: name|ns/op|allocs/op\n");
+    for (const auto& result : results) {
+        fprintf(f, "%s|%.1f|%.2f\n", result.name.c_str(), result.nsPerOp, result.allocsPerOp);
+    }
+    fclose(f);
+    printf("baseline saved to %s\n", path);
+    return true;
+}
+
+// returns the number of regressions, -1 if the baseline cannot be read
+// the times are only compared with a tolerance >= 0
+static int compareBaseline(const char* path, double tolerance) {
+    FILE* f = fopen(path, "r");
+    if (f == nullptr) {
+        perror(path);
+        return -1;
+    }
+    int regressions = 0;
+    char line[256];
+    printf("\n%-36s %10s %10s %8s %8s\n", "against baseline", "ns/op", "was", "allocs", "were");
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        char* sep1 = strchr(line, '|');
+        char* sep2 = sep1 != nullptr ? strchr(sep1 + 1, '|') : nullptr;
+        if (line[0] == '#' || sep2 == nullptr) {
+            continue;
+        }
+        *sep1 = 0;
+        double baseNs = atof(sep1 + 1);
+        double baseAllocs = atof(sep2 + 1);
+
+        for (const auto& result : results) {
+            if (result.name != line) {
+                continue;
+            }
+            bool slower = tolerance >= 0 && result.nsPerOp > baseNs * (1 + tolerance);
+            bool allocates = result.allocsPerOp > baseAllocs + 0.005;
+            printf("%-36s %10.1f %10.1f %8.2f %8.2f %s\n", line, result.nsPerOp, baseNs, result.allocsPerOp, baseAllocs,
+                allocates ? "REGRESSION (allocations)" : slower ? "REGRESSION (time)" : "ok");
+            regressions += (slower || allocates) ? 1 : 0;
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    const char* baselinePath = nullptr;
+    const char* savePath = nullptr;
+    double tolerance = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            fprintf(stderr, "%s needs a value\n", argv[i]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--filter") == 0) filter = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0) baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--save") == 0) savePath = argv[++i];
+        else if (strcmp(argv[i], "--min-time-ms") == 0) minTimeNs = strtoull(argv[++i], nullptr, 10) * 1000000;
+        else if (strcmp(argv[i], "--tolerance") == 0) tolerance = atof(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    esphome_host::logLevel = ESPHOME_LOG_LEVEL_NONE;
+
+    benchFrameReader();
+    benchCodec();
+    benchProtocolTables();
+    benchFunctions();
+    benchComponent();
+
+    if (savePath != nullptr && !saveBaseline(savePath)) {
+        return 2;
+    }
+    if (baselinePath != nullptr) {
+        int regressions = compareBaseline(baselinePath, tolerance);
+        if (regressions != 0) {
+            printf("%d regression(s)\n", regressions < 0 ? 0 : regressions);
+            return regressions < 0 ? 2 : 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,310 @@
+/**
+ * Runs the unmodified cn105 component on a Linux host, against the emulated indoor unit
+ * of tools/cn105Emulator.h (in the same process, virtual time), or against a PTY or a TCP
+ * serial bridge (wall clock time).
+ *
+ * In virtual time the clock fast-forwards to the next event (timeout, byte from the unit,
+ * end of the coalescing window...), so days of polling run in a few seconds; --uptime-days
+ * starts the clock late, e.g. 49.7 to cross the wrap of the 32 bits millis().
+ *
+ * build (from the repository root):
+ *   g++ -std=gnu++17 -O2 -g -DARDUINO=100 -Itools/host/include -Icomponents/cn105 -Itools \
+ *       $(find components/cn105 -name "*.cpp") tools/host/esphome_host.cpp tools/host/cn105_host.cpp -o cn105_host
+ * profiling:
+ *   perf record -g ./cn105_host --duration 86400 && perf report
+ *   valgrind --tool=callgrind ./cn105_host --duration 3600
+ * usage:
+ *   ./cn105_host [options]
+ *   --duration S         seconds to run (default 600)
+ *   --uptime-days D      uptime of the device at the start (default 0)
+ *   --step               advances the virtual clock by 1 ms per loop instead of fast-forwarding
+ *   --update-interval MS poll interval of the component (default 2000)
+ *   --min-update-interval MS, --max-update-interval MS   bounds of the adaptive poll interval
+ *   --set-temp S:T       control() call setting the target temperature T at second S, repeatable
+ *   --remote-temp S:T    set_remote_temperature(T) at second S, repeatable
+ *   --short-write S      the first packet written from second S is cut in half, like a send on a dying link
+ *   --pty PATH           talks to a PTY or tty instead of the emulator (wall clock)
+ *   --tcp HOST:PORT      talks to a serial bridge instead of the emulator (wall clock)
+ *   --delay-ms N, --jitter-ms N, --drop P, --corrupt P, --legacy-temp, --isee, --seed N
+ *                        emulator options, see tools/cn105_emulator.cpp
+ *   --trace              dumps the packet trace of the component at the end
+ *   -v / -q              debug logs / errors only
+ * tests:
+ *   tools/host/cn105_host_tests.sh ./cn105_host    runs scenarios and checks their report
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "esphome.h"
+#include "esphomeHost.h"
+#include "cn105.h"
+#include "ptyTransport.h"
+#include "tcpTransport.h"
+#include "cn105Emulator.h"
+
+struct scheduledCommand {
+    uint64_t atUs;
+    float temperature;
+    bool remote;
+    bool done;
+    uint64_t appliedUs;         // when the emulated unit received it, 0 until then
+};
+
+// the component reads the same clock as the timeouts of the shim
+class hostClock : public cn105Clock {
+public:
+    uint64_t nowMs() override {
+        return esphome_host::nowUs() / 1000;
+    }
+    uint64_t nowUs() override {
+        return esphome_host::nowUs();
+    }
+};
+
+/**
+ * loopback whose first write from cutAtUs on only takes half of the bytes
+*/
+class cuttingLoopback : public loopbackTransport {
+public:
+    size_t write(const uint8_t* bytes, size_t length) override {
+        if (this->cutAtUs != 0 && esphome_host::nowUs() >= this->cutAtUs) {
+            this->cutAtUs = 0;
+            length /= 2;
+        }
+        return loopbackTransport::write(bytes, length);
+    }
+
+    uint64_t cutAtUs = 0;
+};
+
+static bool parseCommand(const char* value, bool remote, std::vector<scheduledCommand>& commands) {
+    double seconds;
+    float temperature;
+    if (sscanf(value, "%lf:%f", &seconds, &temperature) != 2) {
+        fprintf(stderr, "expected SECONDS:TEMPERATURE, got %s\n", value);
+        return false;
+    }
+    commands.push_back({ (uint64_t)(seconds * 1000000), temperature, remote, false, 0 });
+    return true;
+}
+
+static uint64_t monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * virtual time jumps to the next thing which can happen, at least 1 ms later like the loop() of the ESP
+*/
+static uint64_t nextEventUs(CN105Climate* climate, const cn105Emulator& emulator, const std::vector<scheduledCommand>& commands, uint64_t startUs) {
+    uint64_t now = esphome_host::nowUs();
+    uint64_t next = std::min(esphome_host::nextTimeoutUs(), emulator.nextTransmitUs());
+    uint64_t deadlineMs = climate->next_loop_deadline_ms();
+    if (deadlineMs != UINT64_MAX) {
+        next = std::min(next, deadlineMs * 1000);
+    }
+    for (const auto& command : commands) {
+        if (!command.done) {
+            next = std::min(next, startUs + command.atUs);
+        }
+    }
+    return std::max(next, now + 1000);
+}
+
+int main(int argc, char** argv) {
+    cn105EmulatorConfig emulatorConfig;
+    double durationS = 600;
+    uint32_t updateIntervalMs = 2000;
+    uint32_t minUpdateIntervalMs = 0;
+    uint32_t maxUpdateIntervalMs = 0;
+    std::vector<scheduledCommand> commands;
+    const char* ptyPath = nullptr;
+    std::string tcpHost;
+    int tcpPort = 0;
+    bool trace = false;
+    bool step = false;
+    double uptimeDays = 0;
+    double shortWriteS = -1;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool flag = strcmp(arg, "-v") == 0 || strcmp(arg, "-q") == 0 || strcmp(arg, "--trace") == 0 ||
+            strcmp(arg, "--legacy-temp") == 0 || strcmp(arg, "--isee") == 0 || strcmp(arg, "--step") == 0;
+        const char* value = (!flag && i + 1 < argc) ? argv[++i] : nullptr;
+        if (!flag && value == nullptr) {
+            fprintf(stderr, "%s needs a value\n", arg);
+            return 1;
+        }
+
+        if (strcmp(arg, "--duration") == 0) durationS = atof(value);
+        else if (strcmp(arg, "--uptime-days") == 0) uptimeDays = atof(value);
+        else if (strcmp(arg, "--step") == 0) step = true;
+        else if (strcmp(arg, "--update-interval") == 0) updateIntervalMs = atoi(value);
+        else if (strcmp(arg, "--min-update-interval") == 0) minUpdateIntervalMs = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--max-update-interval") == 0) maxUpdateIntervalMs = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--set-temp") == 0) { if (!parseCommand(value, false, commands)) return 1; }
+        else if (strcmp(arg, "--remote-temp") == 0) { if (!parseCommand(value, true, commands)) return 1; }
+        else if (strcmp(arg, "--short-write") == 0) shortWriteS = atof(value);
+        else if (strcmp(arg, "--pty") == 0) ptyPath = value;
+        else if (strcmp(arg, "--tcp") == 0) {
+            const char* colon = strrchr(value, ':');
+            if (colon == nullptr) {
+                fprintf(stderr, "expected HOST:PORT, got %s\n", value);
+                return 1;
+            }
+            tcpHost.assign(value, colon - value);
+            tcpPort = atoi(colon + 1);
+        }
+        else if (strcmp(arg, "--delay-ms") == 0) emulatorConfig.replyDelayUs = atoi(value) * 1000;
+        else if (strcmp(arg, "--jitter-ms") == 0) emulatorConfig.jitterUs = atoi(value) * 1000;
+        else if (strcmp(arg, "--drop") == 0) emulatorConfig.dropRate = atof(value);
+        else if (strcmp(arg, "--corrupt") == 0) emulatorConfig.corruptRate = atof(value);
+        else if (strcmp(arg, "--seed") == 0) emulatorConfig.seed = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--legacy-temp") == 0) emulatorConfig.tempMode = false;
+        else if (strcmp(arg, "--isee") == 0) emulatorConfig.iSee = true;
+        else if (strcmp(arg, "--trace") == 0) trace = true;
+        else if (strcmp(arg, "-v") == 0) esphome_host::logLevel = ESPHOME_LOG_LEVEL_DEBUG;
+        else if (strcmp(arg, "-q") == 0) esphome_host::logLevel = ESPHOME_LOG_LEVEL_ERROR;
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+    }
+
+    bool emulated = ptyPath == nullptr && tcpPort == 0;
+    cn105Transport* transport;
+    cuttingLoopback loopback;
+    if (ptyPath != nullptr) {
+        transport = new ptyTransport(ptyPath);
+    } else if (tcpPort != 0) {
+        transport = new tcpTransport(tcpHost, tcpPort);
+    } else {
+        transport = &loopback;
+    }
+    esphome_host::advanceUs((uint64_t)(uptimeDays * 86400e6));
+    esphome_host::useWallClock(!emulated);
+
+    cn105Emulator emulator(emulatorConfig);
+
+    hostClock clock;
+    CN105Climate* climate = new CN105Climate(&Serial);
+    climate->set_clock(&clock);
+    climate->set_transport(transport);
+    climate->set_baud_rate(2400);
+    climate->set_update_interval(updateIntervalMs);
+    climate->set_min_update_interval(minUpdateIntervalMs);
+    climate->set_max_update_interval(maxUpdateIntervalMs);
+    if (esphome_host::logLevel >= ESPHOME_LOG_LEVEL_DEBUG) {
+        for (uint8_t subsystem = 0; subsystem < LOG_SUBSYSTEM_COUNT; subsystem++) {
+            climate->set_log_level(subsystem, ESPHOME_LOG_LEVEL_DEBUG);
+        }
+    }
+    climate->setup();
+
+    uint64_t startUs = esphome_host::nowUs();
+    if (shortWriteS >= 0) {
+        loopback.cutAtUs = startUs + (uint64_t)(shortWriteS * 1000000) + 1;
+    }
+    uint64_t endUs = startUs + (uint64_t)(durationS * 1000000);
+    uint64_t wallStartUs = monotonicUs();
+    uint64_t loops = 0;
+    std::vector<uint8_t> bytes;
+
+    while (esphome_host::nowUs() < endUs) {
+        uint64_t now = esphome_host::nowUs();
+
+        for (auto& command : commands) {
+            if (!command.done && now - startUs >= command.atUs) {
+                command.done = true;
+                if (command.remote) {
+                    climate->set_remote_temperature(command.temperature);
+                } else {
+                    auto call = climate->make_call();
+                    call.set_target_temperature(command.temperature);
+                    call.perform();
+                }
+            }
+        }
+
+        esphome_host::runScheduler();
+        climate->loop();
+        loops++;
+
+        if (emulated) {
+            uint8_t buffer[LOOPBACK_TRANSPORT_SIZE];
+            size_t n = loopback.peerRead(buffer, sizeof(buffer));
+            if (n > 0) {
+                emulator.receive(buffer, n, now);
+            }
+            bytes.clear();
+            if (emulator.transmit(now, bytes) > 0) {
+                loopback.peerWrite(bytes.data(), bytes.size());
+            }
+
+            for (auto& command : commands) {
+                if (command.done && !command.remote && command.appliedUs == 0 &&
+                    emulator.getSettings().getTemperature() == command.temperature) {
+                    command.appliedUs = now;
+                }
+            }
+            esphome_host::advanceUs(step ? 1000 : std::min(nextEventUs(climate, emulator, commands, startUs), endUs) - now);
+        } else {
+            usleep(1000);
+        }
+    }
+
+    double simulatedS = (esphome_host::nowUs() - startUs) / 1000000.0;
+    double wallS = (monotonicUs() - wallStartUs) / 1000000.0;
+    if (trace) {
+        climate->dump_packet_trace();
+    }
+
+    printf("ran %.1f s in %.3f s of wall time, %llu loops\n", simulatedS, wallS, (unsigned long long)loops);
+    printf("climate: %u publishes, mode %d, target %.1f, current %.1f, %u coalesced commands, %u suppressed publishes, poll interval %u ms\n",
+        climate->publishes, climate->mode, climate->target_temperature, climate->current_temperature,
+        climate->get_coalesced_commands(), climate->get_suppressed_publishes(), climate->get_poll_interval());
+    const rttEstimator& rtt = climate->get_round_trip_times().overall();
+    printf("rtt: %u samples, srtt %.1f ms, rttvar %.1f ms, reply timeout %u ms\n",
+        rtt.samples(), rtt.srttUs() / 1000.0, rtt.rttvarUs() / 1000.0, rtt.timeoutMs());
+    const txQueueStats& tx = climate->get_tx_queue_stats();
+    printf("tx: %u sent, %u reply timeouts, %u retransmits, %u failed, %u unmatched replies\n",
+        tx.sent, tx.replyTimeouts, tx.retransmits, tx.failed, tx.unmatchedReplies);
+    for (int kind = 0; kind < LATENCY_KIND_COUNT; kind++) {
+        char line[256];
+        if (climate->get_latency_histogram((latencyKind)kind).samples() > 0) {
+            climate->get_latency_histogram((latencyKind)kind).format(line, sizeof(line));
+            printf("latency %s: %s\n", LATENCY_NAMES[kind], line);
+        }
+    }
+    printf("health:");
+    for (int counter = 0; counter < HEALTH_COUNTER_COUNT; counter++) {
+        printf("%s %s %u", counter == 0 ? "" : ",", HEALTH_COUNTER_NAMES[counter], climate->get_health_counter((healthCounter)counter));
+    }
+    printf("\n");
+
+    if (emulated) {
+        const cn105EmulatorStats& stats = emulator.getStats();
+        printf("unit: connect %u, set %u, info %u (%.1f/min), replies %u, dropped %u, corrupted %u\n",
+            stats.requests[0x5A], stats.requests[0x41], stats.requests[0x42], stats.requests[0x42] * 60 / simulatedS,
+            stats.replies, stats.dropped, stats.corrupted);
+        for (const auto& command : commands) {
+            if (command.remote) {
+                continue;
+            }
+            if (command.appliedUs != 0) {
+                printf("set-temp %.1f at %.3f s: applied by the unit after %.1f ms\n", command.temperature,
+                    command.atUs / 1000000.0, (command.appliedUs - startUs - command.atUs) / 1000.0);
+            } else {
+                printf("set-temp %.1f at %.3f s: not applied\n", command.temperature, command.atUs / 1000000.0);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#!/bin/bash
+# Scenarios run by cn105_host against the emulated indoor unit, in virtual time: each one
+# checks lines of the report printed at the end of the run.
+#
+# usage (from the repository root, cn105_host built as described in tools/host/cn105_host.cpp):
+#   tools/host/cn105_host_tests.sh [path of cn105_host, default ./cn105_host]
+# exit code 1 if a scenario fails, its report is printed then
+
+HOST=${1:-./cn105_host}
+failures=0
+scenario=""
+output=""
+
+# run NAME OPTIONS...: runs cn105_host, the next checks apply to its report
+run() {
+    scenario=$1
+    shift
+    output=$("$HOST" -q "$@" 2>&1)
+    echo "$scenario"
+}
+
+fail() {
+    echo "  FAILED: $1"
+    echo "$output" | sed 's/^/    /'
+    failures=$((failures + 1))
+}
+
+# expect TEXT: the report contains this text
+expect() {
+    echo "$output" | grep -qF -- "$1" || fail "expected \"$1\""
+}
+
+# expect_counter NAME OP VALUE: a counter of the health line, e.g. expect_counter "RX Info Frames" -ge 100
+expect_counter() {
+    local value
+    value=$(echo "$output" | sed -n "s/^health:.* $1 \([0-9]*\).*/\1/p")
+    [ -n "$value" ] && [ "$value" "$2" "$3" ] || fail "expected $1 $2 $3, got \"$value\""
+}
+
+run "a setpoint set back to the current one while the set packet is in flight is sent" \
+    --duration 120 --set-temp 10:22 --set-temp 10.4:21
+expect "set-temp 22.0 at 10.000 s: applied"
+expect "set-temp 21.0 at 10.400 s: applied"
+expect_counter "Reconnects ACK Timeout" -eq 0
+expect_counter "RX Info Frames" -ge 100
+
+run "a setpoint set back within the coalescing window sends nothing and the polls go on" \
+    --duration 120 --set-temp 10:22 --set-temp 10.1:21
+expect_counter "TX Set Frames" -eq 0
+expect_counter "Coalesced Commands" -eq 1
+expect_counter "Reconnects ACK Timeout" -eq 0
+expect_counter "RX Info Frames" -ge 100
+
+run "a heatpump which never replies is tried again at the poll interval, not at each loop" \
+    --duration 120 --drop 1 --remote-temp 20:20 --remote-temp 50:21
+expect_counter "Reconnects Link Inactive" -le 1
+expect_counter "TX Connect Frames" -le 40
+expect_counter "TX Set Frames" -eq 0
+
+run "replies jittered by up to 60 ms on a steady link are not retransmitted" \
+    --duration 3600 --jitter-ms 60
+expect ", 0 reply timeouts, 0 retransmits,"
+
+run "a packet written short is sent again whole once the link is opened again" \
+    --duration 120 --short-write 30
+expect_counter "Failed Writes" -eq 1
+expect_counter "Reconnects Link Inactive" -eq 1
+expect_counter "RX Info Frames" -ge 100
+expect ", 0 failed,"
+
+run "a poll interval doubled towards a large max_update_interval does not wrap" \
+    --duration 20000000 --max-update-interval 4000000000
+expect "poll interval 4000000000 ms"
+
+if [ $failures -ne 0 ]; then
+    echo "$failures failed"
+    exit 1
+fi
+echo "all passed"
@@ -0,0 +1,185 @@
+/**
+ * Implementation of the host shim: clock, scheduler and logger (see include/esphomeHost.h)
+*/
+#include <stdarg.h>
+#include <time.h>
+#include <algorithm>
+#include <list>
+
+#include "esphome.h"
+#include "esphomeHost.h"
+
+HardwareSerial Serial;
+
+namespace esphome {
+Application App;
+}
+
+namespace esphome_host {
+
+int logLevel = ESPHOME_LOG_LEVEL_INFO;
+
+static bool wallClock = false;
+static uint64_t virtualUs = 0;
+static uint64_t wallStartUs = 0;
+
+static uint64_t monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t nowUs() {
+    return wallClock ? monotonicUs() - wallStartUs + virtualUs : virtualUs;
+}
+
+void advanceUs(uint64_t us) {
+    virtualUs += us;
+}
+
+// the time already elapsed is kept when switching
+void useWallClock(bool enabled) {
+    if (enabled == wallClock) {
+        return;
+    }
+    if (enabled) {
+        wallStartUs = monotonicUs();
+    } else {
+        virtualUs = nowUs();
+    }
+    wallClock = enabled;
+}
+
+void log(int level, const char* tag, const char* format, ...) {
+    static const char LEVELS[] = "-EWICDVV";
+    fprintf(stderr, "%10.3f [%c][%s]: ", nowUs() / 1000000.0, LEVELS[level & 7], tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+struct scheduledItem {
+    esphome::Component* component;
+    std::string name;
+    uint64_t dueUs;
+    uint32_t intervalMs;        // 0 for a timeout
+    uint64_t sequence;
+    std::function<void()> f;
+    bool removed;
+};
+
+static std::list<scheduledItem> items;
+static uint64_t nextSequence = 0;
+
+static void schedule(esphome::Component* component, const std::string& name, uint32_t delayMs, uint32_t intervalMs, std::function<void()>&& f) {
+    items.push_back({ component, name, nowUs() + (uint64_t)delayMs * 1000, intervalMs, nextSequence++, std::move(f), false });
+}
+
+static bool cancel(esphome::Component* component, const std::string& name) {
+    bool found = false;
+    for (auto& item : items) {
+        if (item.component == component && item.name == name && !item.removed) {
+            item.removed = true;
+            found = true;
+        }
+    }
+    return found;
+}
+
+size_t runScheduler() {
+    uint64_t now = nowUs();
+
+    // only the items due now are run, the ones they create wait for the next call
+    std::vector<scheduledItem*> due;
+    for (auto& item : items) {
+        if (!item.removed && item.dueUs <= now) {
+            due.push_back(&item);
+        }
+    }
+    std::sort(due.begin(), due.end(), [](const scheduledItem* a, const scheduledItem* b) {
+        return a->dueUs != b->dueUs ? a->dueUs < b->dueUs : a->sequence < b->sequence;
+    });
+
+    size_t ran = 0;
+    for (scheduledItem* item : due) {
+        if (item->removed) {
+            continue;       // cancelled by a previous callback
+        }
+        std::function<void()> f = item->f;
+        if (item->intervalMs == 0) {
+            item->removed = true;
+        } else {
+            item->dueUs += (uint64_t)item->intervalMs * 1000;
+        }
+        f();
+        ran++;
+    }
+
+    items.remove_if([](const scheduledItem& item) { return item.removed; });
+    return ran;
+}
+
+uint64_t nextTimeoutUs() {
+    uint64_t next = UINT64_MAX;
+    for (const auto& item : items) {
+        if (!item.removed && item.dueUs < next) {
+            next = item.dueUs;
+        }
+    }
+    return next;
+}
+
+size_t pendingTimeouts() {
+    size_t count = 0;
+    for (const auto& item : items) {
+        count += item.removed ? 0 : 1;
+    }
+    return count;
+}
+
+static void removeComponent(esphome::Component* component) {
+    for (auto& item : items) {
+        if (item.component == component) {
+            item.removed = true;
+        }
+    }
+}
+
+}
+
+uint32_t millis() {
+    return (uint32_t)(esphome_host::nowUs() / 1000);
+}
+
+uint32_t micros() {
+    return (uint32_t)esphome_host::nowUs();
+}
+
+namespace esphome {
+
+Component::~Component() {
+    esphome_host::removeComponent(this);
+}
+
+// like esphome, a new timeout replaces the one of the same name
+void Component::set_timeout(const std::string& name, uint32_t timeout, std::function<void()>&& f) {
+    esphome_host::cancel(this, name);
+    esphome_host::schedule(this, name, timeout, 0, std::move(f));
+}
+
+bool Component::cancel_timeout(const std::string& name) {
+    return esphome_host::cancel(this, name);
+}
+
+void Component::set_interval(const std::string& name, uint32_t interval, std::function<void()>&& f) {
+    esphome_host::cancel(this, name);
+    esphome_host::schedule(this, name, interval, interval, std::move(f));
+}
+
+bool Component::cancel_interval(const std::string& name) {
+    return esphome_host::cancel(this, name);
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+/**
+ * Host shim of the Arduino APIs used by the cn105 component, see tools/host/cn105_host.cpp
+ * The time comes from the host clock of esphomeHost.h.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <deque>
+
+typedef uint8_t byte;
+#define SERIAL_8E1 0x1a
+
+uint32_t millis();
+uint32_t micros();
+
+/**
+ * in-memory UART: what the component writes goes to tx, what it reads comes from rx
+ * the host transports (ptyTransport, tcpTransport, loopbackTransport) are usually a better fit,
+ * this one only exists for the default uartTransport of the component
+*/
+class HardwareSerial {
+public:
+    void begin(unsigned long /*baud*/, int /*config*/ = SERIAL_8E1) { opened = true; }
+    void begin(unsigned long baud, int config, int /*rxPin*/, int /*txPin*/) { begin(baud, config); }
+    void pins(int /*txPin*/, int /*rxPin*/) {}
+    void end() { opened = false; }
+    int available() { return (int)rx.size(); }
+    int availableForWrite() { return opened ? 128 : 0; }
+    int read() {
+        if (rx.empty()) return -1;
+        int c = rx.front();
+        rx.pop_front();
+        return c;
+    }
+    size_t read(uint8_t* buffer, size_t length) {
+        size_t n = 0;
+        while (n < length && !rx.empty()) {
+            buffer[n++] = rx.front();
+            rx.pop_front();
+        }
+        return n;
+    }
+    size_t write(uint8_t c) {
+        tx.push_back(c);
+        return 1;
+    }
+    size_t write(const uint8_t* bytes, size_t length) {
+        tx.insert(tx.end(), bytes, bytes + length);
+        return length;
+    }
+
+    std::deque<uint8_t> rx;
+    std::deque<uint8_t> tx;
+    bool opened = false;
+};
+
+extern HardwareSerial Serial;
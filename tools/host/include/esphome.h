@@ -0,0 +1,264 @@
+#pragma once
+/**
+ * Host shim of the esphome APIs used by the cn105 component, see tools/host/cn105_host.cpp
+ * Only what the component calls is provided: climate::Climate, Component timeouts,
+ * sensor / binary_sensor / text_sensor / select entities, App.register_* and the log macros.
+ * Entities record what they publish so that a host program can look at it.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+#include <optional>
+#include "Arduino.h"
+
+#define ESPHOME_LOG_LEVEL_NONE 0
+#define ESPHOME_LOG_LEVEL_ERROR 1
+#define ESPHOME_LOG_LEVEL_WARN 2
+#define ESPHOME_LOG_LEVEL_INFO 3
+#define ESPHOME_LOG_LEVEL_CONFIG 4
+#define ESPHOME_LOG_LEVEL_DEBUG 5
+#define ESPHOME_LOG_LEVEL_VERBOSE 6
+#define ESPHOME_LOG_LEVEL_VERY_VERBOSE 7
+#ifndef ESPHOME_LOG_LEVEL
+#define ESPHOME_LOG_LEVEL ESPHOME_LOG_LEVEL_VERBOSE
+#endif
+
+namespace esphome_host {
+// messages above this level are not printed, can be changed at runtime
+extern int logLevel;
+void log(int level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+}
+
+#define ESP_HOST_LOG(level, tag, ...) do { if (ESPHOME_LOG_LEVEL >= (level) && esphome_host::logLevel >= (level)) { esphome_host::log(level, tag, __VA_ARGS__); } } while (0)
+#define ESP_LOGE(tag, ...) ESP_HOST_LOG(ESPHOME_LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESP_HOST_LOG(ESPHOME_LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESP_HOST_LOG(ESPHOME_LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESP_HOST_LOG(ESPHOME_LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ESP_HOST_LOG(ESPHOME_LOG_LEVEL_VERBOSE, tag, __VA_ARGS__)
+#define YESNO(b) ((b) ? "YES" : "NO")
+#define TRUEFALSE(b) ((b) ? "TRUE" : "FALSE")
+
+namespace esphome {
+template<typename T> using optional = std::optional<T>;
+
+namespace setup_priority {
+const float AFTER_WIFI = 250.0f;
+}
+
+enum EntityCategory : uint8_t {
+    ENTITY_CATEGORY_NONE = 0,
+    ENTITY_CATEGORY_CONFIG = 1,
+    ENTITY_CATEGORY_DIAGNOSTIC = 2
+};
+
+/**
+ * timeouts and intervals are run by esphome_host::runScheduler(), in the order of their due time
+ * then of their creation, so a run is reproducible
+*/
+class Component {
+public:
+    virtual ~Component();
+    virtual void setup() {}
+    virtual void loop() {}
+    virtual float get_setup_priority() const { return 0; }
+
+    void set_timeout(const std::string& name, uint32_t timeout, std::function<void()>&& f);
+    bool cancel_timeout(const std::string& name);
+    void set_interval(const std::string& name, uint32_t interval, std::function<void()>&& f);
+    bool cancel_interval(const std::string& name);
+};
+
+class EntityBase {
+public:
+    void set_name(const char* name) { this->name_ = name; }
+    const std::string& get_name() const { return this->name_; }
+    void set_entity_category(EntityCategory category) { this->category_ = category; }
+    void set_internal(bool internal) { this->internal_ = internal; }
+
+protected:
+    std::string name_;
+    EntityCategory category_ = ENTITY_CATEGORY_NONE;
+    bool internal_ = false;
+};
+
+namespace sensor {
+class Sensor : public EntityBase {
+public:
+    void set_unit_of_measurement(const char* unit) { this->unit_ = unit; }
+    void set_accuracy_decimals(int8_t /*decimals*/) {}
+    void publish_state(float state) {
+        this->state = state;
+        this->publishes++;
+    }
+
+    float state = NAN;
+    uint32_t publishes = 0;
+
+protected:
+    std::string unit_;
+};
+}
+
+namespace binary_sensor {
+class BinarySensor : public EntityBase {
+public:
+    void publish_state(bool state) {
+        this->state = state;
+        this->publishes++;
+    }
+    void publish_initial_state(bool state) { this->state = state; }
+
+    bool state = false;
+    uint32_t publishes = 0;
+};
+}
+
+namespace text_sensor {
+class TextSensor : public EntityBase {
+public:
+    void publish_state(const std::string& state) {
+        this->state = state;
+        this->publishes++;
+    }
+
+    std::string state;
+    uint32_t publishes = 0;
+};
+}
+
+namespace select {
+class SelectTraits {
+public:
+    void set_options(std::vector<std::string> options) { this->options_ = std::move(options); }
+    const std::vector<std::string>& get_options() const { return this->options_; }
+
+private:
+    std::vector<std::string> options_;
+};
+
+class Select : public EntityBase {
+public:
+    virtual ~Select() = default;
+    void publish_state(const std::string& state) {
+        this->state = state;
+        this->publishes++;
+    }
+
+    SelectTraits traits;
+    std::string state;
+    uint32_t publishes = 0;
+
+protected:
+    virtual void control(const std::string& value) = 0;
+};
+}
+
+namespace climate {
+enum ClimateMode : uint8_t {
+    CLIMATE_MODE_OFF = 0, CLIMATE_MODE_HEAT_COOL, CLIMATE_MODE_COOL, CLIMATE_MODE_HEAT,
+    CLIMATE_MODE_FAN_ONLY, CLIMATE_MODE_DRY, CLIMATE_MODE_AUTO
+};
+enum ClimateAction : uint8_t {
+    CLIMATE_ACTION_OFF = 0, CLIMATE_ACTION_COOLING = 2, CLIMATE_ACTION_HEATING = 3,
+    CLIMATE_ACTION_IDLE = 4, CLIMATE_ACTION_DRYING = 5, CLIMATE_ACTION_FAN = 6
+};
+enum ClimateFanMode : uint8_t {
+    CLIMATE_FAN_ON = 0, CLIMATE_FAN_OFF, CLIMATE_FAN_AUTO, CLIMATE_FAN_LOW, CLIMATE_FAN_MEDIUM,
+    CLIMATE_FAN_HIGH, CLIMATE_FAN_MIDDLE, CLIMATE_FAN_FOCUS, CLIMATE_FAN_DIFFUSE, CLIMATE_FAN_QUIET
+};
+enum ClimateSwingMode : uint8_t {
+    CLIMATE_SWING_OFF = 0, CLIMATE_SWING_BOTH, CLIMATE_SWING_VERTICAL, CLIMATE_SWING_HORIZONTAL
+};
+
+class ClimateTraits {
+public:
+    void set_supports_action(bool /*supports*/) {}
+    void set_supports_current_temperature(bool /*supports*/) {}
+    void set_supports_two_point_target_temperature(bool /*supports*/) {}
+    void set_visual_min_temperature(float /*temperature*/) {}
+    void set_visual_max_temperature(float /*temperature*/) {}
+    void set_visual_temperature_step(float /*step*/) {}
+    void set_supported_modes(std::set<ClimateMode> modes) { this->modes_ = std::move(modes); }
+    void add_supported_mode(ClimateMode mode) { this->modes_.insert(mode); }
+    void set_supported_fan_modes(std::set<ClimateFanMode> modes) { this->fan_modes_ = std::move(modes); }
+    void add_supported_fan_mode(ClimateFanMode mode) { this->fan_modes_.insert(mode); }
+    void set_supported_swing_modes(std::set<ClimateSwingMode> modes) { this->swing_modes_ = std::move(modes); }
+    void add_supported_swing_mode(ClimateSwingMode mode) { this->swing_modes_.insert(mode); }
+
+private:
+    std::set<ClimateMode> modes_;
+    std::set<ClimateFanMode> fan_modes_;
+    std::set<ClimateSwingMode> swing_modes_;
+};
+
+class Climate;
+
+class ClimateCall {
+public:
+    explicit ClimateCall(Climate* parent) : parent_(parent) {}
+    ClimateCall& set_mode(ClimateMode mode) { this->mode_ = mode; return *this; }
+    ClimateCall& set_target_temperature(float temperature) { this->target_temperature_ = temperature; return *this; }
+    ClimateCall& set_fan_mode(ClimateFanMode mode) { this->fan_mode_ = mode; return *this; }
+    ClimateCall& set_swing_mode(ClimateSwingMode mode) { this->swing_mode_ = mode; return *this; }
+    void perform();
+
+    const optional<ClimateMode>& get_mode() const { return this->mode_; }
+    const optional<float>& get_target_temperature() const { return this->target_temperature_; }
+    const optional<ClimateFanMode>& get_fan_mode() const { return this->fan_mode_; }
+    const optional<ClimateSwingMode>& get_swing_mode() const { return this->swing_mode_; }
+
+private:
+    Climate* parent_;
+    optional<ClimateMode> mode_;
+    optional<float> target_temperature_;
+    optional<ClimateFanMode> fan_mode_;
+    optional<ClimateSwingMode> swing_mode_;
+};
+
+class Climate : public EntityBase {
+public:
+    virtual ~Climate() = default;
+    ClimateCall make_call() { return ClimateCall(this); }
+    void publish_state() { this->publishes++; }
+    virtual ClimateTraits traits() = 0;
+
+    ClimateMode mode{ CLIMATE_MODE_OFF };
+    ClimateAction action{ CLIMATE_ACTION_OFF };
+    optional<ClimateFanMode> fan_mode;
+    ClimateSwingMode swing_mode{ CLIMATE_SWING_OFF };
+    float current_temperature{ NAN };
+    float target_temperature{ NAN };
+    uint32_t publishes = 0;
+
+protected:
+    friend class ClimateCall;
+    virtual void control(const ClimateCall& call) = 0;
+};
+
+inline void ClimateCall::perform() {
+    this->parent_->control(*this);
+}
+}
+
+class Application {
+public:
+    void register_sensor(sensor::Sensor* sensor) { this->sensors.push_back(sensor); }
+    void register_binary_sensor(binary_sensor::BinarySensor* sensor) { this->binary_sensors.push_back(sensor); }
+    void register_text_sensor(text_sensor::TextSensor* sensor) { this->text_sensors.push_back(sensor); }
+    void register_select(select::Select* select) { this->selects.push_back(select); }
+
+    std::vector<sensor::Sensor*> sensors;
+    std::vector<binary_sensor::BinarySensor*> binary_sensors;
+    std::vector<text_sensor::TextSensor*> text_sensors;
+    std::vector<select::Select*> selects;
+};
+
+extern Application App;
+}
+
+using namespace esphome;
@@ -0,0 +1,2 @@
+#pragma once
+// the cn105 component includes it but does not store any preference
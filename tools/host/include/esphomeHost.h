@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Control of the host shim by the host program (tools/host/esphome_host.cpp)
+ *
+ * The clock is virtual by default: it only moves when the program advances it, so a run is
+ * reproducible and an hour of polling takes a fraction of a second. useWallClock(true) makes
+ * it follow the monotonic clock of the host, to talk to a real unit or to the emulator.
+*/
+namespace esphome_host {
+
+uint64_t nowUs();
+void advanceUs(uint64_t us);
+void useWallClock(bool wallClock);
+
+// runs the timeouts and intervals which are due, returns how many ran
+size_t runScheduler();
+// due time of the next timeout or interval, UINT64_MAX if there is none
+uint64_t nextTimeoutUs();
+size_t pendingTimeouts();
+
+}
@@ -0,0 +1,236 @@
+/**
+ * Replays a packet trace dumped by CN105Climate::dump_packet_trace() through the frame decoder
+ *
+ * build (from the repository root):
+ *   g++ -std=c++17 -O2 -Icomponents/cn105 tools/trace_replay.cpp -o trace_replay
+ * usage:
+ *   ./trace_replay esphome_logs.txt
+ *   esphome logs heatpump.yaml | ./trace_replay
+ *
+ * The lines containing CN105TRACE are extracted from the input, whatever is before the marker
+ * (log level, tag...) is ignored. Each frame is printed with its time relative to the first one
+ * and what it means; the received bytes go through frameReader, as on the ESP.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "frameReader.h"
+#include "cn105Codec.h"
+#include "packetTrace.h"
+
+static void printBytes(const uint8_t* bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        printf("%02X ", bytes[i]);
+    }
+}
+
+static void describeReply(const cn105Frame& frame) {
+    const uint8_t* data = frame.data();
+
+    switch (frame.command()) {
+    case 0x61:
+        printf("set ACK");
+        return;
+    case 0x7A:
+        printf("connect ACK");
+        return;
+    case 0x62:
+        break;
+    default:
+        printf("command %02X", frame.command());
+        return;
+    }
+
+    codecResult result = CODEC_OK;
+    switch (data[0]) {
+    case 0x02: {
+        settingsReply reply{};
+        result = decodeSettings(data, frame.dataLength(), reply);
+        if (result == CODEC_TOO_SHORT) break;
+        const heatpumpSettings& settings = reply.settings;
+        printf("settings: power %s, mode %s%s, target %.1f%s, fan %s, vane %s, widevane %s%s",
+            POWER_MAP.nameAt(settings.power), MODE_MAP.nameAt(settings.mode), settings.iSee ? " (iSee)" : "",
+            settings.getTemperature(), reply.highResTemperature ? "" : " (legacy)",
+            FAN_MAP.nameAt(settings.fan), VANE_MAP.nameAt(settings.vane),
+            WIDEVANE_MAP.nameAt(settings.wideVane), reply.wideVaneAdj ? " (adj)" : "");
+        break;
+    }
+    case 0x03: {
+        heatpumpStatus status;
+        result = decodeRoomTemperature(data, frame.dataLength(), status);
+        if (result == CODEC_TOO_SHORT) break;
+        printf("room temperature: %.1f", status.getRoomTemperature());
+        break;
+    }
+    case 0x05: {
+        heatpumpTimers timers;
+        result = decodeTimers(data, frame.dataLength(), timers);
+        if (result == CODEC_TOO_SHORT) break;
+        printf("timers: %s, on %d/%d, off %d/%d (x%d min)", TIMER_MODE_MAP.nameAt(timers.mode),
+            timers.onMinutesRemaining, timers.onMinutesSet, timers.offMinutesRemaining, timers.offMinutesSet, TIMER_INCREMENT_MINUTES);
+        break;
+    }
+    case 0x06: {
+        heatpumpStatus status;
+        result = decodeStatus(data, frame.dataLength(), status);
+        if (result == CODEC_TOO_SHORT) break;
+        printf("status: compressor %d Hz, operating %d", status.compressorFrequency, status.operating);
+        break;
+    }
+    case FUNCTIONS_GET_PART1:
+    case FUNCTIONS_GET_PART2: {
+        heatpumpFunctions functions;
+        result = decodeFunctions(data, frame.dataLength(), functions);
+        if (result == CODEC_TOO_SHORT) break;
+        printf("functions part %d", data[0] == FUNCTIONS_GET_PART1 ? 1 : 2);
+        break;
+    }
+    default:
+        printf("data %02X", data[0]);
+        break;
+    }
+
+    if (result == CODEC_TOO_SHORT) {
+        printf("data %02X, unexpected length %d", data[0], frame.dataLength());
+    } else if (result == CODEC_UNKNOWN_VALUE) {
+        printf(" (unknown values)");
+    }
+}
+
+static void describeRequest(const uint8_t* bytes, size_t length) {
+    if (length < 6) {
+        printf(length > 1 && bytes[1] == 0x5A ? "connect" : "?");
+        return;
+    }
+    switch (bytes[1]) {
+    case 0x5A:
+        printf("connect");
+        break;
+    case 0x42:
+        printf("request %02X", bytes[5]);
+        break;
+    case 0x41:
+        if (bytes[SET_TYPE_OFFSET] == SET_TYPE_SETTINGS) {
+            printf("set settings, flags %02X %02X", bytes[SET_FLAGS1_OFFSET], bytes[SET_FLAGS2_OFFSET]);
+        } else if (bytes[SET_TYPE_OFFSET] == SET_TYPE_REMOTE_TEMP) {
+            printf("set remote temperature");
+        } else {
+            printf("set %02X", bytes[SET_TYPE_OFFSET]);
+        }
+        break;
+    default:
+        printf("command %02X", bytes[1]);
+    }
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    FILE* input = argc > 1 ? fopen(argv[1], "r") : stdin;
+    if (input == nullptr) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    std::vector<uint8_t> encoded;
+    unsigned long long baseUs = 0;
+    unsigned long expectedEntries = 0;
+    bool inDump = false;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), input) != nullptr) {
+        const char* marker = strstr(line, PACKET_TRACE_MARKER);
+        if (marker == nullptr) {
+            continue;
+        }
+        const char* rest = marker + strlen(PACKET_TRACE_MARKER);
+
+        if (*rest == '+' && inDump) {
+            for (const char* p = rest + 1; *p != '\0'; p++) {
+                int high = hexValue(p[0]);
+                int low = high == -1 ? -1 : hexValue(p[1]);
+                if (low != -1) {
+                    encoded.push_back((uint8_t)(high << 4 | low));
+                    p++;
+                }
+            }
+        } else if (strncmp(rest, " END", 4) == 0) {
+            inDump = false;
+        } else {
+            int version;
+            if (sscanf(rest, " %d %llu %lu", &version, &baseUs, &expectedEntries) == 3) {
+                if (version != PACKET_TRACE_VERSION) {
+                    fprintf(stderr, "unsupported trace version %d\n", version);
+                    return 1;
+                }
+                encoded.clear();        // the last dump of the input is replayed
+                inDump = true;
+            }
+        }
+    }
+
+    frameReader reader;
+    unsigned long long timeUs = 0;
+    unsigned long entries = 0;
+    size_t pos = 0;
+
+    while (pos < encoded.size()) {
+        uint32_t delta = 0;
+        int shift = 0;
+        while (pos < encoded.size()) {
+            uint8_t b = encoded[pos++];
+            delta |= (uint32_t)(b & 0x7F) << shift;
+            shift += 7;
+            if (!(b & 0x80)) break;
+        }
+        if (pos >= encoded.size()) {
+            fprintf(stderr, "truncated entry\n");
+            break;
+        }
+        uint8_t flags = encoded[pos++];
+        size_t length = flags & PACKET_TRACE_LENGTH_MASK;
+        if (pos + length > encoded.size()) {
+            fprintf(stderr, "truncated entry\n");
+            break;
+        }
+        const uint8_t* bytes = &encoded[pos];
+        pos += length;
+        timeUs += delta;
+        entries++;
+
+        printf("%10.3f ms %s ", timeUs / 1000.0, (flags & PACKET_TRACE_TX) ? "TX" : "RX");
+        printBytes(bytes, length);
+        printf("-> ");
+
+        if (flags & PACKET_TRACE_TX) {
+            describeRequest(bytes, length);
+        } else {
+            memcpy(reader.writePointer(), bytes, length);
+            reader.commit(length);
+            cn105Frame frame;
+            bool decoded = false;
+            while (reader.next(frame)) {
+                describeReply(frame);
+                decoded = true;
+            }
+            if (!decoded) {
+                printf("invalid frame");
+                reader.reset();     // each entry is a whole frame, leftovers must not leak into the next one
+            }
+        }
+        printf("\n");
+    }
+
+    const frameReaderStats& stats = reader.getStats();
+    printf("%lu frames (%lu in dump header), starting at %llu us; rx: %lu valid, %lu checksum errors, %lu header errors\n",
+        entries, expectedEntries, baseUs, (unsigned long)stats.frames, (unsigned long)stats.checksumErrors, (unsigned long)stats.headerErrors);
+    return 0;
+}